@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <sys/utsname.h>
+
+#include "iniparser.h"
+#include "ipmi-fru-it.h"
+#include "fru-defs.h"
+
+/*
+ * Micro benchmarks of the generator's hot paths
+ *
+ * Every benchmark runs warmup batches first, then timed repetitions of a
+ * batch of iterations; the per-iteration time of each repetition is
+ * collected and reported as median, p99 and min in JSON:
+ *
+ *   { "benchmarks": [ { "name": ..., "iterations": ..., "repetitions": ...,
+ *                       "median_ns": ..., "p99_ns": ..., "min_ns": ... }, ... ] }
+ *
+ * Usage: fru-bench [-r REPETITIONS] [-w WARMUP] [-c CONFIG] [-o FILE]
+ */
+
+/* From ipmi-fru-it.c, built with -DFRU_IT_LIBRARY */
+extern int ( *packer )( const char *, char ** );
+extern int ( *packerascii )( const char *, int, char ** );
+int pack_ascii6( const char *str, char **raw_data );
+int pack_ascii8_length( const char *str, int type_length, char **raw_data );
+
+#define MASSIVE_SECTIONS    100
+#define MASSIVE_KEYS        100
+
+struct bench
+{
+    const char  *name;
+    void        ( *run )( long iterations );
+    long        iterations;     /* per repetition */
+};
+
+static int repetitions = 50;
+static int warmup = 5;
+static const char *config_file = "bench/bench.conf";
+static char massive_file[] = "/tmp/fru-bench-massive-XXXXXX";
+static char output_file[] = "/tmp/fru-bench-out-XXXXXX";
+
+static dictionary *small_ini, *massive_ini;
+static uint8_t cksum_data[2048];
+static char *image;
+static int image_length;
+
+/* Keeps results alive so the timed calls are not optimised away */
+static volatile long sink;
+
+static double now_ns( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Same shape as iniparser/test/twisted-genhuge.py, smaller */
+static int write_massive_config( void )
+{
+    FILE *f;
+    int fd, i, j;
+
+    if( ( fd = mkstemp( massive_file ) ) == -1 || ( f = fdopen( fd, "w" ) ) == NULL )
+    {
+        perror( "Massive config:" );
+        return -1;
+    }
+    for( i = 0; i < MASSIVE_SECTIONS; i++ )
+    {
+        fprintf( f, "[section%d]\n", i );
+        for( j = 0; j < MASSIVE_KEYS; j++ )
+            fprintf( f, "key%d=value %d of section %d\n", j, j, i );
+        fprintf( f, "\n" );
+    }
+    fclose( f );
+
+    return 0;
+}
+
+static void run_load_small( long n )
+{
+    dictionary *ini;
+
+    while( n-- )
+    {
+        ini = iniparser_load( config_file );
+        sink += ini->n;
+        iniparser_freedict( ini );
+    }
+}
+
+static void run_load_massive( long n )
+{
+    dictionary *ini;
+
+    while( n-- )
+    {
+        ini = iniparser_load( massive_file );
+        sink += ini->n;
+        iniparser_freedict( ini );
+    }
+}
+
+static void run_get_hit( long n )
+{
+    char key[32];
+
+    while( n-- )
+    {
+        snprintf( key, sizeof( key ), "section%ld:key%ld", n % MASSIVE_SECTIONS, n % MASSIVE_KEYS );
+        sink += dictionary_get( massive_ini, key, NULL ) != NULL;
+    }
+}
+
+static void run_get_miss( long n )
+{
+    char key[32];
+
+    while( n-- )
+    {
+        snprintf( key, sizeof( key ), "section%ld:nokey%ld", n % MASSIVE_SECTIONS, n % MASSIVE_KEYS );
+        sink += dictionary_get( massive_ini, key, NULL ) != NULL;
+    }
+}
+
+static void run_pack_ascii6( long n )
+{
+    char *packed;
+
+    while( n-- )
+    {
+        sink += pack_ascii6( "SERVER X1 SERIAL 000000001", &packed );
+        free( packed );
+    }
+}
+
+static void run_pack_ascii8( long n )
+{
+    char *packed;
+
+    while( n-- )
+    {
+        sink += pack_ascii8_length( "Server X1 serial 000000001", 32, &packed );
+        free( packed );
+    }
+}
+
+static void run_cksum_area( long n )
+{
+    while( n-- )
+        sink += get_zero_cksum( cksum_data, 255 );
+}
+
+static void run_cksum_image( long n )
+{
+    while( n-- )
+        sink += get_zero_cksum( cksum_data, sizeof( cksum_data ) );
+}
+
+static void run_gen_fru_data( long n )
+{
+    char *data;
+
+    while( n-- )
+    {
+        sink += gen_fru_data( small_ini, &data );
+        free( data );
+    }
+}
+
+static void run_write_fru_data( long n )
+{
+    while( n-- )
+        sink += write_fru_data( output_file, image, image_length );
+}
+
+static const struct bench benches[] =
+{
+    { "iniparser_load/small",   run_load_small,     200 },
+    { "iniparser_load/massive", run_load_massive,   1 },
+    { "dictionary_get/hit",     run_get_hit,        2000 },
+    { "dictionary_get/miss",    run_get_miss,       2000 },
+    { "pack_ascii6",            run_pack_ascii6,    20000 },
+    { "pack_ascii8_length",     run_pack_ascii8,    20000 },
+    { "get_zero_cksum/255",     run_cksum_area,     20000 },
+    { "get_zero_cksum/2048",    run_cksum_image,    5000 },
+    { "gen_fru_data",           run_gen_fru_data,   500 },
+    { "write_fru_data",         run_write_fru_data, 100 },
+    { NULL, NULL, 0 }
+};
+
+static int compare_double( const void *a, const void *b )
+{
+    double x = *( const double * ) a, y = *( const double * ) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void run_bench( const struct bench *b, FILE *out, int first )
+{
+    double *samples, start;
+    int i;
+
+    for( i = 0; i < warmup; i++ )
+        b->run( b->iterations );
+
+    samples = ( double * ) malloc( repetitions * sizeof( double ) );
+    for( i = 0; i < repetitions; i++ )
+    {
+        start = now_ns();
+        b->run( b->iterations );
+        samples[i] = ( now_ns() - start ) / b->iterations;
+    }
+    qsort( samples, repetitions, sizeof( double ), compare_double );
+
+    fprintf( out, "%s    { \"name\": \"%s\", \"iterations\": %ld, \"repetitions\": %d, "
+             "\"median_ns\": %.1f, \"p99_ns\": %.1f, \"min_ns\": %.1f }",
+             first ? "" : ",\n", b->name, b->iterations, repetitions,
+             samples[repetitions / 2], samples[( repetitions * 99 - 1 ) / 100], samples[0] );
+    free( samples );
+}
+
+int main( int argc, char **argv )
+{
+    const struct bench *b;
+    struct utsname uts;
+    FILE *out = stdout;
+    int c, fd, i;
+
+    while( ( c = getopt( argc, argv, "r:w:c:o:" ) ) != -1 )
+    {
+        switch( c )
+        {
+            case 'r':
+                repetitions = atoi( optarg );
+                break;
+            case 'w':
+                warmup = atoi( optarg );
+                break;
+            case 'c':
+                config_file = optarg;
+                break;
+            case 'o':
+                if( ( out = fopen( optarg, "w" ) ) == NULL )
+                {
+                    perror( "Output open:" );
+                    return EXIT_FAILURE;
+                }
+                break;
+            default:
+                fprintf( stderr, "Usage: %s [-r REPETITIONS] [-w WARMUP] [-c CONFIG] [-o FILE]\n",
+                         argv[0] );
+                return EXIT_FAILURE;
+        }
+    }
+    if( repetitions <= 0 || warmup < 0 )
+    {
+        fprintf( stderr, "Invalid repetition or warmup count\n" );
+        return EXIT_FAILURE;
+    }
+
+    /* As with -a */
+    packer = &pack_ascii6;
+    packerascii = &pack_ascii8_length;
+
+    if( write_massive_config() )
+        return EXIT_FAILURE;
+    if( ( fd = mkstemp( output_file ) ) == -1 )
+    {
+        perror( "Output image:" );
+        return EXIT_FAILURE;
+    }
+    close( fd );
+
+    small_ini = iniparser_load( config_file );
+    massive_ini = iniparser_load( massive_file );
+    if( !small_ini || !massive_ini )
+    {
+        fprintf( stderr, "Cannot load the benchmark configs\n" );
+        return EXIT_FAILURE;
+    }
+    for( i = 0; i < ( int ) sizeof( cksum_data ); i++ )
+        cksum_data[i] = i * 31 + 7;
+    image_length = gen_fru_data( small_ini, &image );
+
+    uname( &uts );
+    fprintf( out, "{\n  \"tool\": \"fru-bench\",\n  \"machine\": \"%s\",\n  \"config\": \"%s\",\n"
+             "  \"benchmarks\": [\n", uts.machine, config_file );
+    for( b = benches, i = 0; b->name; b++, i++ )
+        run_bench( b, out, !i );
+    fprintf( out, "\n  ]\n}\n" );
+
+    if( out != stdout )
+        fclose( out );
+    iniparser_freedict( small_ini );
+    iniparser_freedict( massive_ini );
+    free( image );
+    unlink( massive_file );
+    unlink( output_file );
+
+    return sink < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
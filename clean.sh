@@ -4,7 +4,8 @@ basepath=$(realpath $thisfullscriptname)
 
 cd "${basepath}"
 
-rm -f ./ipmi-fru-it.o
-rm -f ./ipmi-fru-it.d
+rm -f ./*.o
+rm -f ./*.d
 rm -f ./ipmi-fru-it
+rm -f ./bench/*.o ./bench/fru-bench
 echo "Clean files Done!"
\ No newline at end of file
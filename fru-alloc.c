@@ -0,0 +1,387 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <dlfcn.h>
+
+#include "fru-alloc.h"
+#include "fru-stats.h"
+
+#if defined( FRU_STATS ) || defined( FRU_ALLOC_TRACE )
+
+/* Link-time wrappers, see -Wl,--wrap in the Makefile */
+void *__real_malloc( size_t size );
+void *__real_calloc( size_t num, size_t size );
+void *__real_realloc( void *ptr, size_t size );
+char *__real_strdup( const char *str );
+char *__real_strndup( const char *str, size_t size );
+
+#ifdef FRU_ALLOC_TRACE
+
+void __real_free( void *ptr );
+
+#define ALLOC_MAX_SITES     1024
+#define ALLOC_SITE_SLOTS    2048
+#define ALLOC_MIN_BLOCKS    4096
+
+/* One live allocation */
+struct block
+{
+    void        *ptr;
+    size_t      size;
+    uint32_t    site;
+    uint32_t    unit;       /* allocated while generating a unit */
+};
+
+struct site
+{
+    void        *addr;      /* return address into the caller, NULL for "other" */
+    uint64_t    calls;
+    uint64_t    bytes;
+    uint64_t    unit_calls;
+    uint64_t    live;
+    uint64_t    live_bytes;
+    uint64_t    unit_live;
+};
+
+static pthread_mutex_t alloc_lock = PTHREAD_MUTEX_INITIALIZER;
+static int tracking = 1;
+
+/* Live blocks: open addressing on the pointer, linear probing */
+static struct block *blocks;
+static size_t blocks_size, num_blocks;
+
+/* Call sites, indexed by return address; the last one collects the overflow */
+static struct site sites[ALLOC_MAX_SITES];
+static int site_slots[ALLOC_SITE_SLOTS];    /* site index + 1, 0 if free */
+static int num_sites;
+
+static uint64_t total_calls, total_bytes, unit_calls, live_bytes, peak_bytes;
+static uint64_t num_units;
+
+static __thread int in_unit;
+
+static size_t hash_ptr( const void *ptr )
+{
+    return ( ( uintptr_t ) ptr >> 4 ) * 0x9e3779b97f4a7c15ULL >> 16;
+}
+
+static int find_site( void *addr )
+{
+    size_t i = hash_ptr( addr ) & ( ALLOC_SITE_SLOTS - 1 );
+
+    for( ; site_slots[i]; i = ( i + 1 ) & ( ALLOC_SITE_SLOTS - 1 ) )
+    {
+        if( sites[site_slots[i] - 1].addr == addr )
+            return site_slots[i] - 1;
+    }
+    if( num_sites == ALLOC_MAX_SITES - 1 )
+        return ALLOC_MAX_SITES - 1;
+
+    sites[num_sites].addr = addr;
+    site_slots[i] = ++num_sites;
+
+    return num_sites - 1;
+}
+
+static void insert_block( struct block *table, size_t size, const struct block *b )
+{
+    size_t i = hash_ptr( b->ptr ) & ( size - 1 );
+
+    while( table[i].ptr )
+        i = ( i + 1 ) & ( size - 1 );
+    table[i] = *b;
+}
+
+static int grow_blocks( void )
+{
+    struct block *table;
+    size_t size, i;
+
+    size = blocks_size ? blocks_size * 2 : ALLOC_MIN_BLOCKS;
+    if( ( table = ( struct block * ) __real_calloc( size, sizeof( struct block ) ) ) == NULL )
+        return -1;
+    for( i = 0; i < blocks_size; i++ )
+    {
+        if( blocks[i].ptr )
+            insert_block( table, size, &blocks[i] );
+    }
+    __real_free( blocks );
+    blocks = table;
+    blocks_size = size;
+
+    return 0;
+}
+
+/* Backward-shift deletion keeps probe sequences intact without tombstones */
+static int remove_block( void *ptr, struct block *removed )
+{
+    size_t mask, i, j, k;
+
+    if( !blocks )
+        return 0;
+    mask = blocks_size - 1;
+    for( i = hash_ptr( ptr ) & mask; blocks[i].ptr != ptr; i = ( i + 1 ) & mask )
+    {
+        if( !blocks[i].ptr )
+            return 0;
+    }
+    *removed = blocks[i];
+    num_blocks--;
+
+    for( j = i; ; )
+    {
+        blocks[i].ptr = NULL;
+        do
+        {
+            j = ( j + 1 ) & mask;
+            if( !blocks[j].ptr )
+                return 1;
+            k = hash_ptr( blocks[j].ptr ) & mask;
+        }
+        while( i <= j ? ( i < k && k <= j ) : ( i < k || k <= j ) );
+        blocks[i] = blocks[j];
+        i = j;
+    }
+}
+
+static void track( void *ptr, size_t size, void *caller )
+{
+    struct block b;
+    struct site *s;
+
+    if( !ptr || !tracking )
+        return;
+
+    pthread_mutex_lock( &alloc_lock );
+    if( ( num_blocks + 1 ) * 2 > blocks_size && grow_blocks() )
+    {
+        pthread_mutex_unlock( &alloc_lock );
+        return;
+    }
+    b.ptr = ptr;
+    b.size = size;
+    b.site = find_site( caller );
+    b.unit = in_unit;
+    insert_block( blocks, blocks_size, &b );
+    num_blocks++;
+
+    s = &sites[b.site];
+    s->calls++;
+    s->bytes += size;
+    s->live++;
+    s->live_bytes += size;
+    if( in_unit )
+    {
+        s->unit_calls++;
+        s->unit_live++;
+        unit_calls++;
+    }
+    total_calls++;
+    total_bytes += size;
+    live_bytes += size;
+    if( live_bytes > peak_bytes )
+        peak_bytes = live_bytes;
+    pthread_mutex_unlock( &alloc_lock );
+}
+
+/* Blocks allocated before tracking started or by libc itself are not known */
+static void untrack( void *ptr )
+{
+    struct block b;
+    struct site *s;
+
+    if( !ptr || !tracking )
+        return;
+
+    pthread_mutex_lock( &alloc_lock );
+    if( remove_block( ptr, &b ) )
+    {
+        s = &sites[b.site];
+        s->live--;
+        s->live_bytes -= b.size;
+        if( b.unit )
+            s->unit_live--;
+        live_bytes -= b.size;
+    }
+    pthread_mutex_unlock( &alloc_lock );
+}
+
+void fru_alloc_unit_begin( void )
+{
+    in_unit = 1;
+    __atomic_fetch_add( &num_units, 1, __ATOMIC_RELAXED );
+}
+
+void fru_alloc_unit_end( void )
+{
+    in_unit = 0;
+}
+
+/* Units with blocks still live first, then by live and allocated bytes */
+static int compare_sites( const void *a, const void *b )
+{
+    const struct site *x = ( const struct site * ) a, *y = ( const struct site * ) b;
+
+    if( x->unit_live != y->unit_live )
+        return x->unit_live < y->unit_live ? 1 : -1;
+    if( x->live_bytes != y->live_bytes )
+        return x->live_bytes < y->live_bytes ? 1 : -1;
+    return x->bytes < y->bytes ? 1 : x->bytes > y->bytes ? -1 : 0;
+}
+
+static void print_site( FILE *out, const struct site *s )
+{
+    const char *file;
+    uintptr_t offset;
+    char name[256];
+    Dl_info info;
+
+    offset = 0;
+    if( !s->addr )
+        snprintf( name, sizeof( name ), "other" );
+    else if( !dladdr( s->addr, &info ) )
+        snprintf( name, sizeof( name ), "%p", s->addr );
+    else
+    {
+        offset = ( uintptr_t ) s->addr - ( uintptr_t ) info.dli_fbase;
+        file = strrchr( info.dli_fname, '/' ) ? strrchr( info.dli_fname, '/' ) + 1 : info.dli_fname;
+        if( info.dli_sname )
+            snprintf( name, sizeof( name ), "%s+0x%lx", info.dli_sname,
+                      ( unsigned long ) ( ( uintptr_t ) s->addr - ( uintptr_t ) info.dli_saddr ) );
+        else
+            snprintf( name, sizeof( name ), "%s+0x%lx", file, ( unsigned long ) offset );
+    }
+
+    fprintf( out, "    { \"site\": \"%s\", \"offset\": \"0x%lx\", \"allocations\": %llu, "
+             "\"bytes\": %llu, \"unit_allocations\": %llu, \"per_unit\": %.2f, \"live\": %llu, "
+             "\"live_bytes\": %llu, \"unit_live\": %llu }",
+             name, ( unsigned long ) offset, ( unsigned long long ) s->calls,
+             ( unsigned long long ) s->bytes, ( unsigned long long ) s->unit_calls,
+             num_units ? ( double ) s->unit_calls / num_units : 0.0,
+             ( unsigned long long ) s->live, ( unsigned long long ) s->live_bytes,
+             ( unsigned long long ) s->unit_live );
+}
+
+static void report( void )
+{
+    const char *path;
+    uint64_t unit_live;
+    FILE *out = stderr;
+    int i, first;
+
+    /* fopen() and dladdr() may allocate themselves */
+    pthread_mutex_lock( &alloc_lock );
+    tracking = 0;
+    pthread_mutex_unlock( &alloc_lock );
+
+    if( ( path = getenv( "FRU_ALLOC_REPORT" ) ) != NULL && ( out = fopen( path, "w" ) ) == NULL )
+    {
+        perror( "Allocation report open:" );
+        return;
+    }
+
+    unit_live = 0;
+    for( i = 0; i < num_sites; i++ )
+        unit_live += sites[i].unit_live;
+    qsort( sites, num_sites, sizeof( struct site ), compare_sites );
+
+    fprintf( out, "{\n  \"units\": %llu,\n  \"allocations\": %llu,\n  \"allocated_bytes\": %llu,\n"
+             "  \"unit_allocations\": %llu,\n  \"live_blocks\": %llu,\n  \"live_bytes\": %llu,\n"
+             "  \"peak_bytes\": %llu,\n  \"unit_live_blocks\": %llu,\n  \"sites\": [\n",
+             ( unsigned long long ) num_units, ( unsigned long long ) total_calls,
+             ( unsigned long long ) total_bytes, ( unsigned long long ) unit_calls,
+             ( unsigned long long ) num_blocks, ( unsigned long long ) live_bytes,
+             ( unsigned long long ) peak_bytes, ( unsigned long long ) unit_live );
+    for( first = 1, i = 0; i < num_sites; i++ )
+    {
+        if( !sites[i].calls )
+            continue;
+        fprintf( out, "%s", first ? "" : ",\n" );
+        print_site( out, &sites[i] );
+        first = 0;
+    }
+    fprintf( out, "\n  ]\n}\n" );
+
+    if( out != stderr )
+        fclose( out );
+}
+
+/* Registered before main() runs, so it reports after every other exit handler */
+static void __attribute__(( constructor )) alloc_init( void )
+{
+    atexit( report );
+}
+
+void __wrap_free( void *ptr )
+{
+    untrack( ptr );
+    __real_free( ptr );
+}
+
+#else
+
+#define track( ptr, size, caller )  do { } while( 0 )
+#define untrack( ptr )              do { } while( 0 )
+
+#endif
+
+static void count( size_t size )
+{
+    FRU_STATS_COUNT( FRU_STAT_ALLOCS, 1 );
+    FRU_STATS_COUNT( FRU_STAT_ALLOC_BYTES, size );
+}
+
+void *__wrap_malloc( size_t size )
+{
+    void *ptr = __real_malloc( size );
+
+    count( size );
+    track( ptr, size, __builtin_return_address( 0 ) );
+    return ptr;
+}
+
+void *__wrap_calloc( size_t num, size_t size )
+{
+    void *ptr = __real_calloc( num, size );
+
+    count( num * size );
+    track( ptr, num * size, __builtin_return_address( 0 ) );
+    return ptr;
+}
+
+void *__wrap_realloc( void *ptr, size_t size )
+{
+    void *new_ptr = __real_realloc( ptr, size );
+
+    count( size );
+    /* On failure the old block stays valid */
+    if( new_ptr || !size )
+        untrack( ptr );
+    track( new_ptr, size, __builtin_return_address( 0 ) );
+    return new_ptr;
+}
+
+char *__wrap_strdup( const char *str )
+{
+    char *copy = __real_strdup( str );
+    size_t size = strlen( str ) + 1;
+
+    count( size );
+    track( copy, size, __builtin_return_address( 0 ) );
+    return copy;
+}
+
+char *__wrap_strndup( const char *str, size_t size )
+{
+    char *copy = __real_strndup( str, size );
+
+    size = strnlen( str, size ) + 1;
+    count( size );
+    track( copy, size, __builtin_return_address( 0 ) );
+    return copy;
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef FRU_ALLOC_H
+#define FRU_ALLOC_H
+
+/*
+ * Allocation accounting (make ALLOC=1)
+ *
+ * malloc(), calloc(), realloc(), strdup(), strndup() and free() are wrapped
+ * at link time, which covers this tool and iniparser alike. Every live block
+ * is remembered with its size and the call site that allocated it, so the
+ * report printed at exit (to stderr, or to the file named by
+ * $FRU_ALLOC_REPORT) gives the live and peak heap, and per call site the
+ * allocations made, how many of them were made while generating a unit and
+ * how many of those are still live. A unit is one gen_fru_data() call, as
+ * for --stats.
+ *
+ * Steady-state batch generation is allocation-free when no call site shows
+ * unit allocations still live at exit.
+ *
+ * Sites are printed as symbol+offset (only exported symbols are known, so
+ * static functions show as the preceding exported one) and as an offset
+ * into the object for addr2line -f -e.
+ */
+
+#ifdef FRU_ALLOC_TRACE
+
+void fru_alloc_unit_begin( void );
+void fru_alloc_unit_end( void );
+
+#define FRU_ALLOC_UNIT_BEGIN()  fru_alloc_unit_begin()
+#define FRU_ALLOC_UNIT_END()    fru_alloc_unit_end()
+
+#else
+
+#define FRU_ALLOC_UNIT_BEGIN()  do { } while( 0 )
+#define FRU_ALLOC_UNIT_END()    do { } while( 0 )
+
+#endif
+
+#endif
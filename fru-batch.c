@@ -0,0 +1,565 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "fru-batch.h"
+#include "fru-config.h"
+#include "fru-macpool.h"
+#include "fru-patch.h"
+#include "fru-reader.h"
+#include "fru-stats.h"
+#include "fru-template.h"
+#include "fru-uuid.h"
+#include "ipmi-fru-it.h"
+
+/* A field whose value is expanded again for every unit */
+struct unit_field
+{
+    struct fru_slot             slot;
+    const struct fru_template   *tmpl;
+};
+
+struct serial_worker
+{
+    pthread_t                       thread;
+    const struct fru_serial_range   *range;
+    const struct fru_template       *out_tmpl;
+    const uint8_t                   *golden;
+    int                             length;
+    const struct fru_slot           *slots;
+    int                             num_slots;
+    const struct unit_field         *fields;
+    int                             num_fields;
+    int                             mac_offset;     /* MAC record header, -1 if none */
+    int                             mar_offset;     /* MAR record header, -1 if none */
+    const struct fru_template       *uuid_name;
+    long long                       first;
+    long long                       count;
+    long long                       done;
+    int                             ret;
+};
+
+/*
+ * Turn a serial pattern such as "ABC%08d" into a format taking a long long.
+ * Exactly one d/u/x/X conversion is allowed, "%%" is a literal percent.
+ */
+int fru_serial_format( const char *pattern, char *format, int size )
+{
+    const char *p;
+    int pos, conversions;
+
+    pos = conversions = 0;
+    for( p = pattern; *p; p++ )
+    {
+        if( pos + 4 >= size )
+            return -1;
+        format[pos++] = *p;
+        if( *p != '%' )
+            continue;
+        if( p[1] == '%' )
+        {
+            format[pos++] = *++p;
+            continue;
+        }
+        while( p[1] && ( strchr( "-+ 0#", p[1] ) || isdigit( ( unsigned char ) p[1] ) ) )
+        {
+            if( pos + 4 >= size )
+                return -1;
+            format[pos++] = *++p;
+        }
+        if( !p[1] || !strchr( "duxX", p[1] ) )
+            return -1;
+        format[pos++] = 'l';
+        format[pos++] = 'l';
+        format[pos++] = *++p;
+        conversions++;
+    }
+    format[pos] = '\0';
+
+    return conversions == 1 ? 0 : -1;
+}
+
+static void seal_record( uint8_t *image, int offset )
+{
+    struct multi_record_header *h = ( struct multi_record_header * ) ( image + offset );
+
+    h->record_checksum = get_zero_cksum( ( uint8_t * ) ( h + 1 ), h->record_length );
+    h->header_checksum = get_zero_cksum( ( uint8_t * ) h, sizeof( *h ) - 1 );
+}
+
+/* Give a unit fresh MAC addresses */
+static int assign_macs( struct mac_pool *pool, struct mac_block *block, uint8_t *image,
+                        int offset )
+{
+    if( mac_pool_assign( pool, block, ( struct mac_address * ) ( image + offset ) ) )
+        return -1;
+    seal_record( image, offset );
+
+    return 0;
+}
+
+static int assign_uuid( struct serial_worker *w, struct fru_vars *vars, uint8_t *image,
+                        const char *serial, int length )
+{
+    struct management_access_record *mar;
+    char name[1024];
+
+    mar = ( struct management_access_record * ) ( image + w->mar_offset );
+    if( w->range->uuid_version == 4 )
+        fru_uuid_v4( mar->record_data );
+    else
+    {
+        if( w->uuid_name &&
+            ( length = fru_template_expand( w->uuid_name, vars, name, sizeof( name ) ) ) < 0 )
+            return -1;
+        fru_uuid_v5( w->range->uuid_namespace, w->uuid_name ? name : serial, length,
+                     mar->record_data );
+    }
+    seal_record( image, w->mar_offset );
+
+    return 0;
+}
+
+/* Does t use a variable that differs between units? */
+static int is_per_unit( const struct fru_template *t )
+{
+    int i;
+
+    for( i = 0; i < t->num_segments; i++ )
+    {
+        if( t->segments[i].is_var && ( !strcmp( t->segments[i].name, "SERIAL" ) ||
+                                       !strcmp( t->segments[i].name, "SEQ" ) ||
+                                       !strcmp( t->segments[i].name, "UUID" ) ) )
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Slot in the golden image of the field encoded from config key
+ * ("bia:asset_tag", or a custom key). Returns -1 if the key is no field.
+ */
+static int find_field_slot( dictionary *ini, struct fru_image *img, const char *key,
+                            struct fru_slot *slot )
+{
+    char section[16], custom[24], **sec_keys, *str_data;
+    const char *name;
+    struct fru_field *f;
+    int area, num_keys, n, len, i;
+
+    name = strchr( key, ':' );
+    if( !name || name - key >= ( int ) sizeof( section ) )
+        return -1;
+    snprintf( section, sizeof( section ), "%.*s", ( int ) ( name - key ), key );
+    name++;
+    if( ( area = fru_area_by_name( section ) ) < 0 )
+        return -1;
+
+    if( fru_is_predefined_key( area, name ) )
+        f = fru_find_field( img, area, name );
+    else
+    {
+        /* Custom fields are the non-empty, non-predefined keys in config order */
+        n = -1;
+        num_keys = iniparser_getsecnkeys( ini, section );
+        sec_keys = iniparser_getseckeys( ini, section );
+        len = strlen( section ) + 1;
+        for( i = 0, custom[0] = '\0'; i < num_keys; i++ )
+        {
+            if( fru_is_predefined_key( area, sec_keys[i] + len ) )
+                continue;
+            str_data = iniparser_getstring( ini, sec_keys[i], NULL );
+            if( !str_data || !strlen( str_data ) )
+                continue;
+            n++;
+            if( !strcmp( sec_keys[i], key ) )
+            {
+                snprintf( custom, sizeof( custom ), "custom_%d", n + 1 );
+                break;
+            }
+        }
+        free( sec_keys );
+        f = custom[0] ? fru_find_field( img, area, custom ) : NULL;
+    }
+    if( !f )
+        return -1;
+
+    fru_slot_from_field( slot, img, area, f );
+    return 0;
+}
+
+/*
+ * Collect the fields to re-expand per unit. Returns their number, -1 if a
+ * per-unit placeholder sits in a key that cannot be patched in place.
+ */
+static int find_unit_fields( const struct fru_serial_range *range, struct fru_image *img,
+                             struct unit_field **fields )
+{
+    const struct fru_template *t;
+    int num, i;
+
+    *fields = NULL;
+    if( !range->templates || !range->templates->num )
+        return 0;
+    *fields = ( struct unit_field * ) calloc( range->templates->num, sizeof( **fields ) );
+
+    num = 0;
+    for( i = 0; i < range->templates->num; i++ )
+    {
+        t = &range->templates->templates[i];
+        /* The v5 UUID name is handled with the MAR record */
+        if( !is_per_unit( t ) || !strcmp( t->key, "mia_mar:uuid_name" ) )
+            continue;
+        if( find_field_slot( range->ini, img, t->key, &( *fields )[num].slot ) )
+        {
+            fprintf( stderr, "\nError! %s=%s differs per unit, but --serial-range can "
+                     "only patch area fields\n\n", t->key, t->source );
+            free( *fields );
+            *fields = NULL;
+            return -1;
+        }
+        ( *fields )[num++].tmpl = t;
+    }
+
+    return num;
+}
+
+static void *serial_worker_run( void *arg )
+{
+    struct serial_worker *w = ( struct serial_worker * ) arg;
+    struct mac_block block = { 0, 0, 0 };
+    struct fru_vars vars;
+    char serial[64], filename[1024], value[1024];
+    uint8_t *image;
+    long long n;
+    int len, vlen, i;
+
+    image = ( uint8_t * ) malloc( w->length );
+    memcpy( image, w->golden, w->length );
+
+    if( w->range->vars )
+        vars = *w->range->vars;
+    else
+        memset( &vars, 0, sizeof( vars ) );
+    fru_vars_set( &vars, "SERIAL", serial );
+
+    if( w->mac_offset >= 0 )
+    {
+        const struct mac_address *mac = ( const struct mac_address * ) ( w->golden + w->mac_offset );
+
+        /* Every unit but the first of the range draws addresses */
+        block.want = ( w->count - ( w->first == w->range->start ) ) *
+                     ( mac->host_mac_address_count + mac->bmc_mac_address_count +
+                       mac->switch_mac_address_count );
+    }
+
+    for( n = w->first; n < w->first + w->count; n++ )
+    {
+        FRU_STATS_START( start );
+        len = snprintf( serial, sizeof( serial ), w->range->format, n );
+
+        /* Slots keep the previous unit's serial, checksums follow incrementally */
+        for( i = 0; i < w->num_slots; i++ )
+        {
+            if( fru_slot_write( image, &w->slots[i], serial, len ) < 0 )
+            {
+                fprintf( stderr, "\nSerial \"%s\" does not fit its %d byte slot\n\n",
+                         serial, w->slots[i].capacity );
+                w->ret = -1;
+                goto out;
+            }
+        }
+        vars.seq = n;
+        for( i = 0; i < w->num_fields; i++ )
+        {
+            if( ( vlen = fru_template_expand( w->fields[i].tmpl, &vars, value, sizeof( value ) ) ) < 0 ||
+                fru_slot_write( image, &w->fields[i].slot, value, vlen ) < 0 )
+            {
+                if( vlen >= 0 )
+                    fprintf( stderr, "\n%s \"%s\" does not fit its %d byte slot\n\n",
+                             w->fields[i].tmpl->key, value, w->fields[i].slot.capacity );
+                w->ret = -1;
+                goto out;
+            }
+        }
+        FRU_STATS_STAGE( "patch", start );
+
+        /* The golden image already holds the addresses of the first unit */
+        if( w->mac_offset >= 0 && n != w->range->start )
+        {
+            FRU_STATS_START( mac_start );
+            if( assign_macs( w->range->mac_pool, &block, image, w->mac_offset ) )
+            {
+                w->ret = -1;
+                goto out;
+            }
+            FRU_STATS_STAGE( "mac_assign", mac_start );
+        }
+
+        if( w->mar_offset >= 0 && assign_uuid( w, &vars, image, serial, len ) )
+        {
+            w->ret = -1;
+            goto out;
+        }
+
+        if( fru_template_expand( w->out_tmpl, &vars, filename, sizeof( filename ) ) < 0 ||
+            write_fru_data( filename, image, w->length ) )
+        {
+            w->ret = -1;
+            goto out;
+        }
+        w->done++;
+    }
+
+out:
+    if( w->mac_offset >= 0 )
+        mac_pool_release( w->range->mac_pool, &block );
+    free( image );
+    return NULL;
+}
+
+/*
+ * Generate range->count images with sequential serials. Returns the number
+ * of images written, -1 if any unit failed.
+ */
+int fru_serial_range_run( const uint8_t *golden, int length,
+                          const struct fru_serial_range *range )
+{
+    static const int slot_areas[FRU_MAX_SERIAL_SLOTS] =
+    {
+        FRU_AREA_CIA, FRU_AREA_BIA, FRU_AREA_PIA
+    };
+    struct fru_slot slots[FRU_MAX_SERIAL_SLOTS];
+    struct unit_field *fields;
+    struct fru_template out_tmpl, uuid_name;
+    struct serial_worker *workers;
+    struct fru_image img;
+    struct fru_field *f;
+    long long first, per_job, done;
+    int num_slots, num_fields, mac_offset, mar_offset, jobs, ret, i, j;
+
+    if( fru_read_image( golden, length, &img ) )
+    {
+        fprintf( stderr, "\nGolden image could not be parsed\n\n" );
+        return -1;
+    }
+
+    if( ( num_fields = find_unit_fields( range, &img, &fields ) ) < 0 )
+        return -1;
+
+    /*
+     * Every serial_number field with a slot in the golden image gets the
+     * serial, unless its config value is a per-unit template of its own
+     */
+    num_slots = 0;
+    for( i = 0; i < FRU_MAX_SERIAL_SLOTS; i++ )
+    {
+        f = fru_find_field( &img, slot_areas[i], "serial_number" );
+        if( !f || !f->length )
+            continue;
+        fru_slot_from_field( &slots[num_slots], &img, slot_areas[i], f );
+        for( j = 0; j < num_fields && fields[j].slot.data_offset != slots[num_slots].data_offset; j++ )
+            ;
+        if( j == num_fields )
+            num_slots++;
+    }
+    if( !num_slots && !num_fields )
+    {
+        fprintf( stderr, "\nNo serial_number slot in the config, set a placeholder "
+                 "value and serial_number_size\n\n" );
+        free( fields );
+        return -1;
+    }
+
+    mac_offset = mar_offset = -1;
+    for( i = 0; i < img.num_records; i++ )
+    {
+        if( range->mac_pool && img.records[i].type_id == MULTI_RECORD_ID_MAC &&
+            img.records[i].length + ( int ) sizeof( struct multi_record_header ) >=
+            ( int ) sizeof( struct mac_address ) )
+            mac_offset = img.records[i].offset;
+        if( range->uuid_version && img.records[i].type_id == MULTI_RECORD_ID_MAR &&
+            img.records[i].length + ( int ) sizeof( struct multi_record_header ) >=
+            ( int ) sizeof( struct management_access_record ) )
+            mar_offset = img.records[i].offset;
+    }
+    if( range->uuid_name && fru_template_compile( &uuid_name, NULL, range->uuid_name ) < 0 )
+    {
+        free( fields );
+        return -1;
+    }
+
+    if( fru_template_compile( &out_tmpl, NULL, range->outfile ) <= 0 )
+    {
+        fprintf( stderr, "\nError! Output name \"%s\" must contain a placeholder "
+                 "such as ${SERIAL}\n\n", range->outfile );
+        free( fields );
+        return -1;
+    }
+
+    jobs = range->jobs > 0 ? range->jobs : 1;
+    if( jobs > range->count )
+        jobs = range->count ? range->count : 1;
+    workers = ( struct serial_worker * ) calloc( jobs, sizeof( *workers ) );
+
+    /* Contiguous partitions, the first ones take the remainder */
+    per_job = range->count / jobs;
+    first = range->start;
+    for( i = 0; i < jobs; i++ )
+    {
+        workers[i].range = range;
+        workers[i].out_tmpl = &out_tmpl;
+        workers[i].golden = golden;
+        workers[i].length = length;
+        workers[i].slots = slots;
+        workers[i].num_slots = num_slots;
+        workers[i].fields = fields;
+        workers[i].num_fields = num_fields;
+        workers[i].mac_offset = mac_offset;
+        workers[i].mar_offset = mar_offset;
+        workers[i].uuid_name = range->uuid_name ? &uuid_name : NULL;
+        workers[i].first = first;
+        workers[i].count = per_job + ( i < range->count % jobs );
+        first += workers[i].count;
+    }
+
+    if( jobs == 1 )
+        serial_worker_run( &workers[0] );
+    else
+    {
+        for( i = 0; i < jobs; i++ )
+            pthread_create( &workers[i].thread, NULL, serial_worker_run, &workers[i] );
+        for( i = 0; i < jobs; i++ )
+            pthread_join( workers[i].thread, NULL );
+    }
+
+    ret = 0;
+    done = 0;
+    for( i = 0; i < jobs; i++ )
+    {
+        done += workers[i].done;
+        if( workers[i].ret )
+            ret = -1;
+    }
+
+    free( workers );
+    free( fields );
+    fru_template_free( &out_tmpl );
+    if( range->uuid_name )
+        fru_template_free( &uuid_name );
+
+    return ret ? -1 : ( int ) done;
+}
+
+struct multi_worker
+{
+    pthread_t               thread;
+    dictionary              *ini;
+    const struct fru_multi  *multi;
+    fru_gen_fn              gen;
+    int                     *next;      /* next FRU to build, shared by all workers */
+    char                    **data;
+    int                     *length;
+};
+
+static void *multi_worker_run( void *arg )
+{
+    struct multi_worker *w = ( struct multi_worker * ) arg;
+    dictionary *view;
+    int i;
+
+    /* FRUs differ in size, so workers pick them one at a time */
+    while( ( i = __atomic_fetch_add( w->next, 1, __ATOMIC_RELAXED ) ) < w->multi->num )
+    {
+        view = fru_config_view( w->ini, w->multi->names[i] );
+        w->length[i] = w->gen( view, &w->data[i] );
+        fru_config_view_free( view );
+    }
+
+    return NULL;
+}
+
+/* Returns the number of images written, -1 if any FRU failed (nothing is written then) */
+int fru_multi_run( dictionary *ini, const struct fru_multi *multi, fru_gen_fn gen )
+{
+    struct multi_worker *workers;
+    struct fru_template out_tmpl;
+    struct fru_vars vars;
+    char filename[1024], **data;
+    int *length, next, jobs, ret, i;
+
+    if( fru_template_compile( &out_tmpl, NULL, multi->outfile ) <= 0 )
+    {
+        fprintf( stderr, "\nError! Output name \"%s\" must contain ${FRU} "
+                 "for a multi-FRU config\n\n", multi->outfile );
+        return -1;
+    }
+
+    data = ( char ** ) calloc( multi->num, sizeof( char * ) );
+    length = ( int * ) calloc( multi->num, sizeof( int ) );
+
+    jobs = multi->jobs > 0 ? multi->jobs : 1;
+    if( jobs > multi->num )
+        jobs = multi->num;
+    workers = ( struct multi_worker * ) calloc( jobs, sizeof( *workers ) );
+    next = 0;
+    for( i = 0; i < jobs; i++ )
+    {
+        workers[i].ini = ini;
+        workers[i].multi = multi;
+        workers[i].gen = gen;
+        workers[i].next = &next;
+        workers[i].data = data;
+        workers[i].length = length;
+    }
+
+    if( jobs == 1 )
+        multi_worker_run( &workers[0] );
+    else
+    {
+        for( i = 0; i < jobs; i++ )
+            pthread_create( &workers[i].thread, NULL, multi_worker_run, &workers[i] );
+        for( i = 0; i < jobs; i++ )
+            pthread_join( workers[i].thread, NULL );
+    }
+
+    ret = 0;
+    for( i = 0; i < multi->num; i++ )
+    {
+        if( length[i] < 0 )
+        {
+            fprintf( stderr, "\nError generating FRU \"%s\"\n\n", multi->names[i] );
+            ret = -1;
+        }
+        else if( multi->max_size && length[i] > multi->max_size )
+        {
+            fprintf( stderr, "\nError! FRU data length (%d bytes) of \"%s\" exceeds maximum "
+                     "file size (%d bytes)\n\n", length[i], multi->names[i], multi->max_size );
+            ret = -1;
+        }
+    }
+
+    /* All images are good: write them out in one go */
+    memset( &vars, 0, sizeof( vars ) );
+    for( i = 0; !ret && i < multi->num; i++ )
+    {
+        fru_vars_set( &vars, "FRU", multi->names[i] );
+        vars.seq = i + 1;
+        if( fru_template_expand( &out_tmpl, &vars, filename, sizeof( filename ) ) < 0 ||
+            write_fru_data( filename, data[i], length[i] ) )
+            ret = -1;
+        else
+            fprintf( stdout, "FRU file \"%s\" created\n", filename );
+    }
+
+    for( i = 0; i < multi->num; i++ )
+        free( data[i] );
+    free( data );
+    free( length );
+    free( workers );
+    fru_template_free( &out_tmpl );
+
+    return ret ? -1 : multi->num;
+}
@@ -0,0 +1,59 @@
+#ifndef FRU_BATCH_H
+#define FRU_BATCH_H
+
+#include <inttypes.h>
+
+#include "fru-defs.h"
+#include "iniparser.h"
+
+/*
+ * Lot pre-building: the golden image is encoded once, then every unit is a
+ * copy of it with only the serial number slots, the fields whose config
+ * value uses ${SERIAL}, ${SEQ} or ${UUID} (and the MAC and UUID records,
+ * when those are per unit) rewritten in place.
+ */
+
+#define FRU_MAX_SERIAL_SLOTS    3
+
+struct mac_pool;
+struct fru_templates;
+struct fru_vars;
+
+struct fru_serial_range
+{
+    char        format[64];     /* printf pattern for one long long */
+    long long   start;
+    long long   count;
+    int         jobs;           /* worker threads, ranges are split evenly */
+    const char  *outfile;       /* output name template, e.g. FRU-${SERIAL}.bin */
+    struct mac_pool *mac_pool;  /* allocate the MAC record of every unit, or NULL */
+    int         uuid_version;   /* regenerate the MAR UUID per unit: 4, 5 or 0 */
+    uint8_t     uuid_namespace[UUID_BYTE_LENGTH];
+    const char  *uuid_name;     /* v5 name template, NULL for the serial itself */
+    dictionary  *ini;           /* config of the golden image */
+    const struct fru_templates *templates;  /* its placeholders, or NULL */
+    const struct fru_vars *vars;            /* -D and environment variables */
+};
+
+/*
+ * Multi-FRU configs: every FRU is generated from its own view of the one
+ * parsed config on a pool of threads, then all images are written in a
+ * single pass once every one of them has been built.
+ */
+typedef int ( *fru_gen_fn )( dictionary *ini, char **data );
+
+struct fru_multi
+{
+    int         num;
+    char        **names;        /* FRU names, see fru_config_fru_names() */
+    int         jobs;
+    int         max_size;       /* per image, 0 for no limit */
+    const char  *outfile;       /* output name template, e.g. ${FRU}.bin */
+};
+
+int fru_serial_format( const char *pattern, char *format, int size );
+int fru_serial_range_run( const uint8_t *golden, int length,
+                          const struct fru_serial_range *range );
+int fru_multi_run( dictionary *ini, const struct fru_multi *multi, fru_gen_fn gen );
+
+#endif
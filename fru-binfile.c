@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fru-binfile.h"
+
+static struct fru_binfile *binfiles = NULL;
+static pthread_mutex_t binfiles_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int same_file( const struct fru_binfile *bf, const struct stat *st )
+{
+    return bf->dev == st->st_dev && bf->ino == st->st_ino && bf->size == st->st_size &&
+           bf->mtime.tv_sec == st->st_mtim.tv_sec && bf->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+/* The list only ever grows at its head, so it can be walked without the lock */
+static struct fru_binfile *find_binfile( const char *path, const struct stat *st )
+{
+    struct fru_binfile *bf;
+
+    for( bf = __atomic_load_n( &binfiles, __ATOMIC_ACQUIRE ); bf; bf = bf->next )
+    {
+        if( !strcmp( bf->path, path ) && same_file( bf, st ) )
+            return bf;
+    }
+    return NULL;
+}
+
+/*
+ * Returns NULL (with a message) if the file cannot be opened or mapped.
+ * st is the caller's stat() of path, if it has one; the file is opened
+ * only when no mapping matches it.
+ */
+const struct fru_binfile *fru_binfile_map( const char *path, const struct stat *st )
+{
+    struct fru_binfile *bf;
+    struct stat fst;
+    void *map;
+    int fd;
+
+    if( !st )
+    {
+        if( stat( path, &fst ) )
+        {
+            perror( "Bin file open:" );
+            return NULL;
+        }
+        st = &fst;
+    }
+    if( ( bf = find_binfile( path, st ) ) != NULL )
+        return bf;
+
+    pthread_mutex_lock( &binfiles_lock );
+
+    /* Another thread may have mapped it meanwhile */
+    if( ( bf = find_binfile( path, st ) ) != NULL )
+    {
+        fd = -1;
+        goto out;
+    }
+
+    if( ( fd = open( path, O_RDONLY ) ) == -1 || fstat( fd, &fst ) )
+    {
+        perror( "Bin file open:" );
+        bf = NULL;
+        goto out;
+    }
+
+    map = NULL;
+    if( fst.st_size )
+    {
+        map = mmap( NULL, fst.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+        if( map == MAP_FAILED )
+        {
+            perror( "Bin file mmap:" );
+            bf = NULL;
+            goto out;
+        }
+        madvise( map, fst.st_size, MADV_WILLNEED );
+    }
+
+    bf = ( struct fru_binfile * ) calloc( 1, sizeof( *bf ) );
+    bf->path = strdup( path );
+    bf->dev = fst.st_dev;
+    bf->ino = fst.st_ino;
+    bf->mtime = fst.st_mtim;
+    bf->size = fst.st_size;
+    bf->data = ( const uint8_t * ) map;
+    bf->next = binfiles;
+    __atomic_store_n( &binfiles, bf, __ATOMIC_RELEASE );
+
+out:
+    if( fd != -1 )
+        close( fd );
+    pthread_mutex_unlock( &binfiles_lock );
+
+    return bf;
+}
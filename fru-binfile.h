@@ -0,0 +1,32 @@
+#ifndef FRU_BINFILE_H
+#define FRU_BINFILE_H
+
+#include <inttypes.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/*
+ * Read-only mappings of the blobs a config pulls in (IUA bin_file)
+ *
+ * A file is mapped the first time it is asked for and handed out again as
+ * long as it is unchanged, so a batch of units maps it once. A file that
+ * changed (watch mode) is mapped anew; the old mapping stays valid until
+ * exit since another thread may still be copying from it. Finding a
+ * mapping takes no lock and, given the caller's stat(), no system call.
+ */
+
+struct fru_binfile
+{
+    char                *path;
+    dev_t               dev;
+    ino_t               ino;
+    struct timespec     mtime;
+    off_t               size;
+    const uint8_t       *data;      /* NULL for an empty file */
+    struct fru_binfile  *next;
+};
+
+const struct fru_binfile *fru_binfile_map( const char *path, const struct stat *st );
+
+#endif
@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "fru-config.h"
+#include "fru-stats.h"
+#include "fru-trace.h"
+
+/* Same sentinel iniparser uses internally */
+#define INI_INVALID_KEY     ( ( char * ) -1 )
+
+char *fru_config_getstring( dictionary *d, const char *key, char *def )
+{
+    if( d == NULL || key == NULL )
+        return def;
+    FRU_STATS_COUNT( FRU_STAT_LOOKUPS, 1 );
+    return dictionary_get( d, key, def );
+}
+
+int fru_config_getint( dictionary *d, const char *key, int notfound )
+{
+    char *str;
+
+    str = fru_config_getstring( d, key, INI_INVALID_KEY );
+    if( str == INI_INVALID_KEY )
+        return notfound;
+    return ( int ) strtol( str, NULL, 0 );
+}
+
+int fru_config_find_entry( dictionary *d, const char *entry )
+{
+    return fru_config_getstring( d, entry, INI_INVALID_KEY ) != INI_INVALID_KEY;
+}
+
+static int is_section_key( const char *key, const char *section, int length )
+{
+    return !strncmp( key, section, length ) && key[length] == ':';
+}
+
+int fru_config_getsecnkeys( dictionary *d, const char *section )
+{
+    int length, num, i;
+
+    if( !fru_config_find_entry( d, section ) )
+        return 0;
+
+    length = strlen( section );
+    for( num = i = 0; i < d->size; i++ )
+    {
+        if( d->key[i] && is_section_key( d->key[i], section, length ) )
+            num++;
+    }
+    return num;
+}
+
+/* Keys of a section in config order; the array is malloc'd, the keys are not */
+char **fru_config_getseckeys( dictionary *d, const char *section )
+{
+    char **keys;
+    int length, num, i;
+
+    if( !fru_config_find_entry( d, section ) )
+        return NULL;
+
+    keys = ( char ** ) malloc( ( fru_config_getsecnkeys( d, section ) + 1 ) * sizeof( char * ) );
+    length = strlen( section );
+    for( num = i = 0; i < d->size; i++ )
+    {
+        if( d->key[i] && is_section_key( d->key[i], section, length ) )
+            keys[num++] = d->key[i];
+    }
+    return keys;
+}
+
+struct parsed_file
+{
+    char                *path;
+    struct timespec     mtime;
+    off_t               size;
+    dictionary          *ini;
+    struct parsed_file  *next;
+};
+
+static struct parsed_file *parsed_files = NULL;
+
+/* Real paths of the files merged by the last fru_config_load() */
+static const char *loaded_files[64];
+static int num_loaded_files = 0;
+
+static void note_loaded( const char *path )
+{
+    if( num_loaded_files < ( int ) ( sizeof( loaded_files ) / sizeof( loaded_files[0] ) ) )
+        loaded_files[num_loaded_files++] = path;
+}
+
+/* Parse a file, or hand out the earlier parse if the file is unchanged */
+static dictionary *parse_cached( const char *path )
+{
+    struct parsed_file *pf;
+    char real[PATH_MAX];
+    struct stat st;
+
+    if( !realpath( path, real ) || stat( real, &st ) )
+    {
+        fprintf( stderr, "\nCannot open config %s\n\n", path );
+        return NULL;
+    }
+
+    for( pf = parsed_files; pf; pf = pf->next )
+    {
+        if( strcmp( pf->path, real ) )
+            continue;
+        if( pf->mtime.tv_sec == st.st_mtim.tv_sec && pf->mtime.tv_nsec == st.st_mtim.tv_nsec &&
+            pf->size == st.st_size )
+        {
+            note_loaded( pf->path );
+            return pf->ini;
+        }
+        iniparser_freedict( pf->ini );
+        break;
+    }
+    if( !pf )
+    {
+        pf = ( struct parsed_file * ) calloc( 1, sizeof( *pf ) );
+        pf->path = strdup( real );
+        pf->next = parsed_files;
+        parsed_files = pf;
+    }
+
+    note_loaded( pf->path );
+
+    pf->mtime = st.st_mtim;
+    pf->size = st.st_size;
+    FRU_TRACE1( config__load, pf->path );
+    pf->ini = iniparser_load( real );
+    FRU_TRACE2( config__loaded, pf->path, pf->ini ? pf->ini->n : -1 );
+    if( !pf->ini )
+        fprintf( stderr, "\nError parsing INI file %s!\n\n", path );
+
+    return pf->ini;
+}
+
+static int merge_file( dictionary *dst, const char *path, int depth );
+
+static int merge_bases( dictionary *dst, dictionary *src, const char *path, int depth )
+{
+    static const char *directives[] = { ":inherit", ":include", NULL };
+    char base[PATH_MAX], *list, *name, *save;
+    const char *value, *slash, **d;
+    int ret = 0;
+
+    slash = strrchr( path, '/' );
+    for( d = directives; *d && !ret; d++ )
+    {
+        if( ( value = fru_config_getstring( src, *d, NULL ) ) == NULL )
+            continue;
+        list = strdup( value );
+        for( name = strtok_r( list, ", \t", &save ); name && !ret;
+             name = strtok_r( NULL, ", \t", &save ) )
+        {
+            if( name[0] == '/' || !slash )
+                snprintf( base, sizeof( base ), "%s", name );
+            else
+                snprintf( base, sizeof( base ), "%.*s/%s", ( int ) ( slash - path ), path, name );
+            ret = merge_file( dst, base, depth + 1 );
+        }
+        free( list );
+    }
+    return ret;
+}
+
+static int merge_file( dictionary *dst, const char *path, int depth )
+{
+    dictionary *src;
+    int i;
+
+    if( depth > FRU_CONFIG_MAX_DEPTH )
+    {
+        fprintf( stderr, "\nConfig %s: inherit/include nested too deep (a loop?)\n\n", path );
+        return -1;
+    }
+    if( ( src = parse_cached( path ) ) == NULL || merge_bases( dst, src, path, depth ) )
+        return -1;
+
+    for( i = 0; i < src->size; i++ )
+    {
+        if( !src->key[i] || !strcmp( src->key[i], ":inherit" ) ||
+            !strcmp( src->key[i], ":include" ) )
+            continue;
+        if( dictionary_set( dst, src->key[i], src->val[i] ) )
+            return -1;
+    }
+    return 0;
+}
+
+/* Merge files in order, last wins. The result is the caller's to free. */
+dictionary *fru_config_load( char **files, int num )
+{
+    dictionary *ini;
+    int i;
+    FRU_STATS_START( start );
+
+    num_loaded_files = 0;
+    ini = dictionary_new( 0 );
+    for( i = 0; i < num; i++ )
+    {
+        if( merge_file( ini, files[i], 0 ) )
+        {
+            dictionary_del( ini );
+            return NULL;
+        }
+    }
+    FRU_STATS_STAGE( "config_load", start );
+    return ini;
+}
+
+/* Every file the last fru_config_load() read, bases included */
+int fru_config_files( const char ***paths )
+{
+    *paths = loaded_files;
+    return num_loaded_files;
+}
+
+/* FRU name of a "fru.section[:key]" entry, NULL for default entries */
+static const char *fru_prefix( const char *key, int *length )
+{
+    const char *dot, *colon;
+
+    dot = strchr( key, '.' );
+    colon = strchr( key, ':' );
+    if( !dot || dot == key || ( colon && colon < dot ) )
+        return NULL;
+    *length = dot - key;
+    return key;
+}
+
+/* Distinct FRU names in config order, 0 for a single-FRU config */
+int fru_config_fru_names( dictionary *ini, char ***names )
+{
+    const char *prefix;
+    int num, length, i, j;
+
+    num = 0;
+    *names = NULL;
+    for( i = 0; i < ini->size; i++ )
+    {
+        /* Section entries have no ':' and no value */
+        if( !ini->key[i] || strchr( ini->key[i], ':' ) ||
+            ( prefix = fru_prefix( ini->key[i], &length ) ) == NULL )
+            continue;
+        for( j = 0; j < num; j++ )
+        {
+            if( ( int ) strlen( ( *names )[j] ) == length &&
+                !strncmp( ( *names )[j], prefix, length ) )
+                break;
+        }
+        if( j < num )
+            continue;
+        *names = ( char ** ) realloc( *names, ( num + 1 ) * sizeof( char * ) );
+        ( *names )[num++] = strndup( prefix, length );
+    }
+    return num;
+}
+
+static void view_set( dictionary *view, const char *key, int own, char *val )
+{
+    unsigned hash;
+    int i;
+
+    hash = dictionary_hash( key );
+    for( i = 0; i < view->n; i++ )
+    {
+        if( view->hash[i] == hash && !strcmp( view->key[i], key ) )
+        {
+            view->val[i] = val;
+            if( own )
+                free( ( char * ) key );
+            return;
+        }
+    }
+    view->key[view->n] = own ? ( char * ) key : strdup( key );
+    view->val[view->n] = val;
+    view->hash[view->n] = hash;
+    view->n++;
+}
+
+dictionary *fru_config_view( dictionary *ini, const char *fru )
+{
+    dictionary *view;
+    const char *prefix;
+    int length, fru_length, i;
+
+    view = ( dictionary * ) calloc( 1, sizeof( *view ) );
+    view->size = ini->n;
+    view->val = ( char ** ) calloc( ini->n, sizeof( char * ) );
+    view->key = ( char ** ) calloc( ini->n, sizeof( char * ) );
+    view->hash = ( unsigned * ) calloc( ini->n, sizeof( unsigned ) );
+
+    /* Defaults first, so the FRU's own keys replace them in place */
+    for( i = 0; i < ini->size; i++ )
+    {
+        if( ini->key[i] && !fru_prefix( ini->key[i], &length ) )
+            view_set( view, ini->key[i], 0, ini->val[i] );
+    }
+
+    fru_length = strlen( fru );
+    for( i = 0; i < ini->size; i++ )
+    {
+        if( !ini->key[i] || ( prefix = fru_prefix( ini->key[i], &length ) ) == NULL ||
+            length != fru_length || strncmp( prefix, fru, length ) )
+            continue;
+        view_set( view, strdup( ini->key[i] + length + 1 ), 1, ini->val[i] );
+    }
+    view->size = view->n;
+
+    return view;
+}
+
+/* Values belong to the parsed config, only the keys are the view's own */
+void fru_config_view_free( dictionary *view )
+{
+    int i;
+
+    for( i = 0; i < view->n; i++ )
+        free( view->key[i] );
+    free( view->key );
+    free( view->val );
+    free( view->hash );
+    free( view );
+}
@@ -0,0 +1,43 @@
+#ifndef FRU_CONFIG_H
+#define FRU_CONFIG_H
+
+#include "iniparser.h"
+
+/*
+ * Config lookups
+ *
+ * iniparser lowercases every key it is asked for through one static
+ * buffer, which makes its getters unsafe to call from several threads.
+ * Stored keys are lowercase already and so are all the keys the generator
+ * asks for, so these go straight to the dictionary instead.
+ *
+ * Multi-FRU configs prefix sections with a FRU name, e.g. [psu0.pia] or
+ * [backplane.bia]. Un-prefixed sections are defaults shared by every FRU.
+ * fru_config_view() builds the config of one FRU as a dictionary whose
+ * values point into the parsed one, defaults first and the FRU's own keys
+ * overriding them in place.
+ *
+ * fru_config_load() merges several config files, later ones winning. A
+ * file may name base configs with top-level "inherit=" or "include="
+ * keys (comma separated, relative to the file); those are merged before
+ * the file's own keys. Parsed files are kept in memory keyed by path,
+ * modification time and size, so a base shared by many SKU overlays is
+ * parsed once per process.
+ */
+
+#define FRU_CONFIG_MAX_DEPTH    8
+
+char *fru_config_getstring( dictionary *d, const char *key, char *def );
+int fru_config_getint( dictionary *d, const char *key, int notfound );
+int fru_config_find_entry( dictionary *d, const char *entry );
+int fru_config_getsecnkeys( dictionary *d, const char *section );
+char **fru_config_getseckeys( dictionary *d, const char *section );
+
+dictionary *fru_config_load( char **files, int num );
+int fru_config_files( const char ***paths );
+
+int fru_config_fru_names( dictionary *ini, char ***names );
+dictionary *fru_config_view( dictionary *ini, const char *fru );
+void fru_config_view_free( dictionary *view );
+
+#endif
@@ -0,0 +1,855 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fru-decode.h"
+#include "fru-reader.h"
+#include "fru-uuid.h"
+
+/* Minutes of the BIA mfg_datetime count from 1996-01-01 00:00 UTC */
+#define MFG_EPOCH   820454400
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static uint8_t file_buffer[FRU_DECODE_BUFFER];
+
+void fru_writer_init( struct fru_writer *w, int fd )
+{
+    w->fd = fd;
+    w->pos = 0;
+    w->error = 0;
+}
+
+int fru_writer_flush( struct fru_writer *w )
+{
+    int done, ret;
+
+    for( done = 0; done < w->pos; done += ret )
+    {
+        if( ( ret = write( w->fd, w->buf + done, w->pos - done ) ) <= 0 )
+        {
+            perror( "Output write:" );
+            w->error = 1;
+            break;
+        }
+    }
+    w->pos = 0;
+
+    return w->error ? -1 : 0;
+}
+
+static void w_mem( struct fru_writer *w, const char *s, int n )
+{
+    int chunk;
+
+    while( n > 0 )
+    {
+        if( w->pos == FRU_WRITER_SIZE && fru_writer_flush( w ) )
+            return;
+        chunk = FRU_WRITER_SIZE - w->pos < n ? FRU_WRITER_SIZE - w->pos : n;
+        memcpy( w->buf + w->pos, s, chunk );
+        w->pos += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+static void w_str( struct fru_writer *w, const char *s )
+{
+    w_mem( w, s, strlen( s ) );
+}
+
+static void w_char( struct fru_writer *w, char c )
+{
+    if( w->pos == FRU_WRITER_SIZE && fru_writer_flush( w ) )
+        return;
+    w->buf[w->pos++] = c;
+}
+
+static void w_uint( struct fru_writer *w, unsigned long value )
+{
+    char digits[24];
+    int i = sizeof( digits );
+
+    do
+    {
+        digits[--i] = '0' + value % 10;
+        value /= 10;
+    }
+    while( value );
+    w_mem( w, digits + i, sizeof( digits ) - i );
+}
+
+/* Hex bytes, separated by sep unless it is nul */
+static void w_hex( struct fru_writer *w, const uint8_t *data, int length, char sep )
+{
+    int i;
+
+    for( i = 0; i < length; i++ )
+    {
+        if( sep && i )
+            w_char( w, sep );
+        w_char( w, hex_digits[data[i] >> 4] );
+        w_char( w, hex_digits[data[i] & 0xf] );
+    }
+}
+
+/* Bytes are Latin-1, so anything outside printable ASCII becomes \u00XX */
+static void w_json_string( struct fru_writer *w, const char *s, int length )
+{
+    uint8_t c;
+    int i;
+
+    w_char( w, '"' );
+    for( i = 0; i < length; i++ )
+    {
+        c = s[i];
+        if( c == '"' || c == '\\' )
+        {
+            w_char( w, '\\' );
+            w_char( w, c );
+        }
+        else if( c < 0x20 || c > 0x7e )
+        {
+            w_str( w, "\\u00" );
+            w_char( w, hex_digits[c >> 4] );
+            w_char( w, hex_digits[c & 0xf] );
+        }
+        else
+            w_char( w, c );
+    }
+    w_char( w, '"' );
+}
+
+static void w_json_key( struct fru_writer *w, const char *key, int first )
+{
+    if( !first )
+        w_char( w, ',' );
+    w_char( w, '"' );
+    w_str( w, key );
+    w_str( w, "\":" );
+}
+
+static const char *type_name( const struct fru_field *f )
+{
+    if( f->fixed )
+        return "fixed";
+    switch( f->type )
+    {
+        case TYPE_CODE_BCDPLUS:
+            return "bcdplus";
+        case TYPE_CODE_ASCII6:
+            return "ascii6";
+        case TYPE_CODE_UNILATIN:
+            return "ascii8";
+        default:
+            return "binary";
+    }
+}
+
+static unsigned long fixed_value( const struct fru_field *f )
+{
+    unsigned long value = 0;
+    int i;
+
+    for( i = f->length - 1; i >= 0; i-- )
+        value = value << 8 | f->data[i];
+    return value;
+}
+
+/* Every character a field holds, padding included; -1 for binary fields */
+static int field_chars( const struct fru_field *f, char *out, int size )
+{
+    static const char bcd_plus[] = "0123456789 -.???";
+    unsigned value;
+    int n, bit, i;
+
+    n = 0;
+    if( f->fixed )
+        return snprintf( out, size, "%lu", fixed_value( f ) );
+
+    switch( f->type )
+    {
+        case TYPE_CODE_BCDPLUS:
+            for( i = 0; i < f->length && n + 2 < size; i++ )
+            {
+                out[n++] = bcd_plus[f->data[i] >> 4];
+                out[n++] = bcd_plus[f->data[i] & 0xf];
+            }
+            break;
+        case TYPE_CODE_ASCII6:
+            /* Characters are packed LSB first, 6 bits each */
+            for( bit = 0; bit + 6 <= f->length * 8 && n < size; bit += 6 )
+            {
+                value = f->data[bit / 8];
+                if( bit / 8 + 1 < f->length )
+                    value |= f->data[bit / 8 + 1] << 8;
+                out[n++] = ( ( value >> ( bit % 8 ) ) & 0x3f ) + 0x20;
+            }
+            break;
+        case TYPE_CODE_UNILATIN:
+            n = f->length < size ? f->length : size;
+            memcpy( out, f->data, n );
+            break;
+        default:
+            return -1;
+    }
+    return n;
+}
+
+/* Decoded text of a field, without the space padding of sized fields */
+int fru_decode_field_text( const struct fru_field *f, char *out, int size )
+{
+    int n;
+
+    if( ( n = field_chars( f, out, size ) ) < 0 || f->fixed )
+        return n;
+    while( n && ( out[n - 1] == ' ' || out[n - 1] == '\0' ) )
+        n--;
+    return n;
+}
+
+const char *fru_decode_record_name( uint8_t type_id )
+{
+    switch( type_id )
+    {
+        case MULTI_RECORD_ID_PSU:
+            return "mia_psu";
+        case MULTI_RECORD_ID_DC_OUTPUT:
+            return "mia_dc_output";
+        case MULTI_RECORD_ID_DC_LOAD:
+            return "mia_dc_load";
+        case MULTI_RECORD_ID_MAR:
+            return "mia_mar";
+        case MULTI_RECORD_ID_VER:
+            return "mia_ver";
+        case MULTI_RECORD_ID_MAC:
+            return "mia_mac";
+        case MULTI_RECORD_ID_FAN:
+            return "mia_fan";
+        case MULTI_RECORD_ID_BCI:
+            return "mia_bci";
+        case MULTI_RECORD_ID_SC:
+            return "mia_sc";
+        default:
+            return "mia_oem";
+    }
+}
+
+/* ISO date of the BIA mfg_datetime field, 0 for any other field */
+static int field_date( const struct fru_field *f, char *out, int size )
+{
+    struct tm tm;
+    time_t t;
+
+    if( !f->fixed || strcmp( f->name, "mfg_datetime" ) )
+        return 0;
+    t = MFG_EPOCH + fixed_value( f ) * 60;
+    gmtime_r( &t, &tm );
+    return strftime( out, size, "%Y-%m-%dT%H:%MZ", &tm );
+}
+
+static void field_name( const struct fru_field *f, char *out, int size )
+{
+    if( f->name )
+        snprintf( out, size, "%s", f->name );
+    else
+        snprintf( out, size, "custom_%d", f->custom + 1 );
+}
+
+static void json_field( struct fru_writer *w, const struct fru_field *f, int first )
+{
+    char name[32], text[256], date[32];
+    int n;
+
+    field_name( f, name, sizeof( name ) );
+    w_str( w, first ? "{" : ",{" );
+    w_json_key( w, "name", 1 );
+    w_json_string( w, name, strlen( name ) );
+    w_json_key( w, "type", 0 );
+    w_json_string( w, type_name( f ), strlen( type_name( f ) ) );
+    w_json_key( w, "offset", 0 );
+    w_uint( w, f->offset );
+    w_json_key( w, "length", 0 );
+    w_uint( w, f->length );
+    w_json_key( w, "raw", 0 );
+    w_char( w, '"' );
+    w_hex( w, f->data, f->length, 0 );
+    w_char( w, '"' );
+    w_json_key( w, "text", 0 );
+    if( ( n = fru_decode_field_text( f, text, sizeof( text ) ) ) < 0 )
+        w_str( w, "null" );
+    else
+        w_json_string( w, text, n );
+
+    if( ( n = field_date( f, date, sizeof( date ) ) ) > 0 )
+    {
+        w_json_key( w, "date", 0 );
+        w_json_string( w, date, n );
+    }
+    w_char( w, '}' );
+}
+
+static void json_image( struct fru_writer *w, const char *name, const struct fru_image *img,
+                        int ok )
+{
+    const struct fru_area *a;
+    const struct fru_record *r;
+    int i, j, first;
+
+    w_char( w, '{' );
+    w_json_key( w, "file", 1 );
+    w_json_string( w, name, strlen( name ) );
+    w_json_key( w, "size", 0 );
+    w_uint( w, img->length );
+    w_json_key( w, "header_ok", 0 );
+    w_str( w, img->header_ok ? "true" : "false" );
+    w_json_key( w, "ok", 0 );
+    w_str( w, ok ? "true" : "false" );
+
+    w_json_key( w, "areas", 0 );
+    w_char( w, '[' );
+    for( first = 1, i = 0; i < FRU_AREA_NUM; i++ )
+    {
+        a = &img->areas[i];
+        if( !a->present )
+            continue;
+        w_str( w, first ? "{" : ",{" );
+        first = 0;
+        w_json_key( w, "area", 1 );
+        w_json_string( w, fru_area_name( i ), strlen( fru_area_name( i ) ) );
+        w_json_key( w, "offset", 0 );
+        w_uint( w, a->offset );
+        w_json_key( w, "length", 0 );
+        w_uint( w, a->length );
+        if( i == FRU_AREA_IUA )
+        {
+            w_json_key( w, "raw", 0 );
+            w_char( w, '"' );
+            w_hex( w, img->data + a->offset, a->length, 0 );
+            w_char( w, '"' );
+        }
+        else
+        {
+            w_json_key( w, "checksum_ok", 0 );
+            w_str( w, a->cksum_ok ? "true" : "false" );
+            w_json_key( w, "fields", 0 );
+            w_char( w, '[' );
+            for( j = 0; j < a->num_fields; j++ )
+                json_field( w, &a->fields[j], !j );
+            w_char( w, ']' );
+        }
+        w_char( w, '}' );
+    }
+    w_char( w, ']' );
+
+    w_json_key( w, "records", 0 );
+    w_char( w, '[' );
+    for( i = 0; i < img->num_records; i++ )
+    {
+        r = &img->records[i];
+        w_str( w, i ? ",{" : "{" );
+        w_json_key( w, "record", 1 );
+        w_json_string( w, fru_decode_record_name( r->type_id ), strlen( fru_decode_record_name( r->type_id ) ) );
+        w_json_key( w, "type_id", 0 );
+        w_uint( w, r->type_id );
+        w_json_key( w, "format_version", 0 );
+        w_uint( w, r->format_version & ~MULTI_RECORD_EOL );
+        w_json_key( w, "offset", 0 );
+        w_uint( w, r->offset );
+        w_json_key( w, "length", 0 );
+        w_uint( w, r->length );
+        w_json_key( w, "checksum_ok", 0 );
+        w_str( w, r->cksum_ok ? "true" : "false" );
+        w_json_key( w, "raw", 0 );
+        w_char( w, '"' );
+        w_hex( w, r->data, r->length, 0 );
+        w_char( w, '"' );
+        w_char( w, '}' );
+    }
+    w_str( w, "]}\n" );
+}
+
+static void text_line( struct fru_writer *w, const char *fmt, ... )
+    __attribute__(( format( printf, 2, 3 ) ));
+
+static void text_line( struct fru_writer *w, const char *fmt, ... )
+{
+    char line[256];
+    va_list ap;
+    int n;
+
+    va_start( ap, fmt );
+    n = vsnprintf( line, sizeof( line ), fmt, ap );
+    va_end( ap );
+    w_mem( w, line, n < ( int ) sizeof( line ) ? n : ( int ) sizeof( line ) - 1 );
+}
+
+static void text_image( struct fru_writer *w, const char *name, const struct fru_image *img,
+                        int ok )
+{
+    const struct fru_field *f;
+    const struct fru_area *a;
+    const struct fru_record *r;
+    char field[32], text[256], date[32];
+    int i, j, n;
+
+    text_line( w, "%s: %d bytes, common header %s%s\n", name, img->length,
+               img->header_ok ? "ok" : "invalid", ok ? "" : ", parse error" );
+    for( i = 0; i < FRU_AREA_NUM; i++ )
+    {
+        a = &img->areas[i];
+        if( !a->present )
+            continue;
+        if( i == FRU_AREA_IUA )
+        {
+            text_line( w, "%s at 0x%x, %d bytes\n  raw ", fru_area_name( i ), a->offset,
+                       a->length );
+            w_hex( w, img->data + a->offset, a->length, ' ' );
+            w_char( w, '\n' );
+            continue;
+        }
+        text_line( w, "%s at 0x%x, %d bytes, checksum %s\n", fru_area_name( i ), a->offset,
+                   a->length, a->cksum_ok ? "ok" : "BAD" );
+        for( j = 0; j < a->num_fields; j++ )
+        {
+            f = &a->fields[j];
+            field_name( f, field, sizeof( field ) );
+            text_line( w, "  %-16s %-8s", field, type_name( f ) );
+            n = fru_decode_field_text( f, text, sizeof( text ) );
+            if( f->fixed )
+            {
+                w_mem( w, text, n );
+                if( field_date( f, date, sizeof( date ) ) > 0 )
+                    text_line( w, " (%s)", date );
+                w_str( w, "  " );
+            }
+            else if( n >= 0 )
+            {
+                w_json_string( w, text, n );
+                w_str( w, "  " );
+            }
+            w_char( w, '[' );
+            w_hex( w, f->data, f->length, ' ' );
+            w_str( w, "]\n" );
+        }
+    }
+    for( i = 0; i < img->num_records; i++ )
+    {
+        r = &img->records[i];
+        text_line( w, "record 0x%02x (%s) v%d at 0x%x, %d bytes, checksum %s\n  raw ",
+                   r->type_id, fru_decode_record_name( r->type_id ), r->format_version & ~MULTI_RECORD_EOL,
+                   r->offset, r->length, r->cksum_ok ? "ok" : "BAD" );
+        w_hex( w, r->data, r->length, ' ' );
+        w_char( w, '\n' );
+    }
+}
+
+/*
+ * INI output: a config ipmi-fru-it re-encodes to the same bytes. Whatever
+ * the generator cannot produce is left as a "; lossy:" comment and makes
+ * the image count as failed.
+ */
+struct ini_ctx
+{
+    struct fru_writer   *w;
+    const char          *name;
+    char                prefix[64];     /* FRU name and '.', or empty */
+    int                 lossy;
+};
+
+static void ini_lossy( struct ini_ctx *c, const char *what, const char *why )
+{
+    text_line( c->w, "; lossy: %s %s\n", what, why );
+    c->lossy++;
+}
+
+static void ini_section( struct ini_ctx *c, const char *section )
+{
+    text_line( c->w, "\n[%s%s]\n", c->prefix, section );
+}
+
+/*
+ * iniparser strips blanks around values (quoted or not), stops unquoted
+ * ones at ';' or '#' and joins lines ending in '\'; the templates expand
+ * "${". Returns -1 for a value that cannot survive that.
+ */
+static int ini_value( struct ini_ctx *c, const char *key, const char *s, int n )
+{
+    char quote;
+    int i;
+
+    if( !n || s[0] == ' ' || s[n - 1] == ' ' || s[n - 1] == '\\' )
+        return -1;
+    quote = 0;
+    for( i = 0; i < n; i++ )
+    {
+        if( ( uint8_t ) s[i] < 0x20 || s[i] == 0x7f || ( s[i] == '$' && i + 1 < n && s[i + 1] == '{' ) )
+            return -1;
+        if( s[i] == ';' || s[i] == '#' || s[i] == '\'' )
+            quote = quote ? quote : '"';
+        if( s[i] == '"' )
+            quote = '\'';
+    }
+    if( quote && memchr( s, quote, n ) )
+        return -1;
+
+    w_str( c->w, key );
+    w_char( c->w, '=' );
+    if( quote )
+        w_char( c->w, quote );
+    w_mem( c->w, s, n );
+    if( quote )
+        w_char( c->w, quote );
+    w_char( c->w, '\n' );
+    return 0;
+}
+
+/* Predefined fields are 8-bit ASCII padded with spaces to their _size */
+static void ini_predefined( struct ini_ctx *c, int area, const struct fru_field *f )
+{
+    const char *size_key;
+    char what[40];
+    int n;
+
+    snprintf( what, sizeof( what ), "%s:%s", fru_area_name( area ), f->name );
+    if( f->type == TYPE_CODE_BINARY && !f->length )
+        return;
+    if( f->type != TYPE_CODE_UNILATIN )
+    {
+        ini_lossy( c, what, "is not 8-bit ASCII" );
+        return;
+    }
+
+    for( n = f->length; n && f->data[n - 1] == ' '; n-- )
+        ;
+    if( ini_value( c, f->name, ( const char * ) f->data, n ) )
+    {
+        ini_lossy( c, what, "is empty or cannot be written as an INI value" );
+        return;
+    }
+    size_key = fru_field_size_key( area, f->name );
+    if( n != f->length && size_key )
+        text_line( c->w, "%s=%d\n", size_key, f->length );
+}
+
+/* Custom fields are 6-bit ASCII, keeping as many chars as fill the bytes */
+static void ini_custom( struct ini_ctx *c, int area, const struct fru_field *f )
+{
+    char what[40], key[24], text[96];
+    int n;
+
+    snprintf( what, sizeof( what ), "%s:custom_%d", fru_area_name( area ), f->custom + 1 );
+    if( f->type != TYPE_CODE_ASCII6 || !f->length )
+    {
+        ini_lossy( c, what, "is not 6-bit ASCII" );
+        return;
+    }
+
+    n = field_chars( f, text, sizeof( text ) );
+    while( n && text[n - 1] == ' ' && ( ( n - 1 ) * 6 + 7 ) / 8 == f->length )
+        n--;
+    snprintf( key, sizeof( key ), "custom_%d", f->custom + 1 );
+    if( ini_value( c, key, text, n ) )
+        ini_lossy( c, what, "cannot be written as an INI value" );
+}
+
+static void ini_area( struct ini_ctx *c, const struct fru_image *img, int id )
+{
+    const struct fru_area *a = &img->areas[id];
+    const struct fru_field *f;
+    int i, used, minimal;
+
+    ini_section( c, fru_area_name( id ) );
+    if( !a->cksum_ok )
+        ini_lossy( c, fru_area_name( id ), "has a bad checksum" );
+
+    for( i = 0; i < a->num_fields; i++ )
+    {
+        f = &a->fields[i];
+        if( f->fixed )
+        {
+            if( !strcmp( f->name, "chassis_type" ) && !fixed_value( f ) )
+                ini_lossy( c, "cia:chassis_type", "is 0" );
+            text_line( c->w, "%s=%lu\n", f->name, fixed_value( f ) );
+        }
+        else if( f->name )
+            ini_predefined( c, id, f );
+        else
+            ini_custom( c, id, f );
+    }
+
+    /* Past the end marker the generator leaves zeros, 2 or 6 bytes and alignment */
+    for( i = a->end_offset + 1; i < a->cksum_offset; i++ )
+    {
+        if( img->data[i] )
+        {
+            ini_lossy( c, fru_area_name( id ), "has data after its end marker" );
+            break;
+        }
+    }
+    used = a->end_offset - a->offset + ( id == FRU_AREA_PIA ? 2 : 6 );
+    minimal = ( used + 7 ) & ~7;
+    if( a->length > minimal )
+        text_line( c->w, "; %d bytes of padding: regenerate with --layout hot-cold --reserve %d\n",
+                   a->length - minimal, a->length - minimal );
+}
+
+/* Anything but the default IUA goes to a bin_file next to the image */
+static void ini_iua( struct ini_ctx *c, const struct fru_image *img )
+{
+    const struct fru_area *a = &img->areas[FRU_AREA_IUA];
+    const uint8_t *data = img->data + a->offset;
+    char path[PATH_MAX];
+    int fd, i, plain;
+
+    ini_section( c, "iua" );
+
+    plain = a->length == sizeof( struct internal_use_area ) && data[0] == 0x01 &&
+            data[1] == 0x05 && data[a->length - 2] == 0xc1 && !( uint8_t ) ( 0x01 + 0x05 + 0xc1 + data[a->length - 1] );
+    for( i = 2; plain && i < a->length - 2; i++ )
+        plain = !data[i];
+    if( plain )
+        return;
+
+    snprintf( path, sizeof( path ), "%s.iua", c->name );
+    if( ( fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) == -1 ||
+        write( fd, data + 1, a->length - 1 ) != a->length - 1 )
+    {
+        perror( "IUA bin_file write:" );
+        ini_lossy( c, "iua", "could not be saved" );
+    }
+    else if( ini_value( c, "bin_file", path, strlen( path ) ) )
+        ini_lossy( c, "iua", "bin_file name cannot be written as an INI value" );
+    if( fd != -1 )
+        close( fd );
+    if( data[0] != 0x01 )
+        ini_lossy( c, "iua", "format version is not 1" );
+}
+
+static void ini_record_header( struct ini_ctx *c, const char *section, int instance,
+                               const struct fru_record *r )
+{
+    if( instance > 1 )
+        text_line( c->w, "\n[%s%s%d]\n", c->prefix, section, instance );
+    else
+        ini_section( c, section );
+    text_line( c->w, "type_id=0x%02x\nformat_version=%d\n", r->type_id,
+               r->format_version & ~MULTI_RECORD_EOL );
+}
+
+static int is_zero( const uint8_t *data, int length )
+{
+    while( length-- )
+    {
+        if( *data++ )
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * The Management Access Record and MAC records are written as such, since
+ * the hot-cold layout classifies them as per unit; every other record is
+ * kept as raw mia_oem bytes, which reproduce it exactly.
+ */
+static void ini_records( struct ini_ctx *c, const struct fru_image *img )
+{
+    const struct management_access_record *mar;
+    const struct mac_address *mac;
+    const struct fru_record *r;
+    char uuid[40];
+    int i, num_mar, num_mac, num_oem;
+
+    num_mar = num_mac = num_oem = 0;
+    for( i = 0; i < img->num_records; i++ )
+    {
+        r = &img->records[i];
+        mar = ( const struct management_access_record * ) ( r->data - sizeof( struct multi_record_header ) );
+        mac = ( const struct mac_address * ) ( r->data - sizeof( struct multi_record_header ) );
+        if( !r->cksum_ok )
+            ini_lossy( c, fru_decode_record_name( r->type_id ), "has a bad checksum" );
+
+        if( r->type_id == MULTI_RECORD_ID_MAR && !num_mar &&
+            r->length == sizeof( *mar ) - sizeof( struct multi_record_header ) &&
+            is_zero( mar->pad, sizeof( mar->pad ) ) )
+        {
+            ini_record_header( c, "mia_mar", ++num_mar, r );
+            fru_uuid_format( mar->record_data, uuid );
+            text_line( c->w, "sub_type=%d\nrecord_data=%s\n", mar->sub_record_type, uuid );
+        }
+        else if( r->type_id == MULTI_RECORD_ID_MAC &&
+                 r->length == sizeof( *mac ) - sizeof( struct multi_record_header ) &&
+                 is_zero( mac->pad, sizeof( mac->pad ) ) )
+        {
+            ini_record_header( c, "mia_mac", ++num_mac, r );
+            text_line( c->w, "host_mac_address_count=%d\nhost_base_mac_address=", mac->host_mac_address_count );
+            w_hex( c->w, mac->host_base_mac_address, MAC_ADDRESS_BYTE_LENGTH, 0 );
+            text_line( c->w, "\nbmc_mac_address_count=%d\nbmc_base_mac_address=", mac->bmc_mac_address_count );
+            w_hex( c->w, mac->bmc_base_mac_address, MAC_ADDRESS_BYTE_LENGTH, 0 );
+            text_line( c->w, "\nswitch_mac_address_count=%d\nswitch_base_mac_address=",
+                       mac->switch_mac_address_count );
+            w_hex( c->w, mac->switch_base_mac_address, MAC_ADDRESS_BYTE_LENGTH, 0 );
+            w_char( c->w, '\n' );
+        }
+        else
+        {
+            ini_record_header( c, "mia_oem", ++num_oem, r );
+            if( r->length )
+            {
+                w_str( c->w, "record_data=" );
+                w_hex( c->w, r->data, r->length, ' ' );
+                w_char( c->w, '\n' );
+            }
+        }
+    }
+}
+
+/* FRU name for a multi-FRU config: the file name without directory and extension */
+static void ini_prefix( struct ini_ctx *c, const char *name )
+{
+    const char *base;
+    int n;
+
+    base = strrchr( name, '/' ) ? strrchr( name, '/' ) + 1 : name;
+    for( n = 0; base[n] && base[n] != '.' && n < ( int ) sizeof( c->prefix ) - 2; n++ )
+        c->prefix[n] = isalnum( ( uint8_t ) base[n] ) || base[n] == '-' ? tolower( base[n] ) : '_';
+    c->prefix[n++] = '.';
+    c->prefix[n] = '\0';
+}
+
+static int ini_image( struct fru_writer *w, const char *name, const struct fru_image *img,
+                      int ok, int multi )
+{
+    struct ini_ctx c;
+    int i, end;
+
+    c.w = w;
+    c.name = name;
+    c.prefix[0] = '\0';
+    c.lossy = 0;
+    if( multi )
+        ini_prefix( &c, name );
+
+    text_line( w, "; %s\n", name );
+    if( !ok || !img->header_ok )
+        ini_lossy( &c, name, "is not a valid FRU image" );
+
+    if( img->areas[FRU_AREA_IUA].present )
+        ini_iua( &c, img );
+    for( i = FRU_AREA_CIA; i < FRU_AREA_NUM; i++ )
+    {
+        if( img->areas[i].present )
+            ini_area( &c, img, i );
+    }
+    ini_records( &c, img );
+
+    end = ( img->used_length + 7 ) & ~7;
+    if( img->length > end )
+        text_line( w, "; %d bytes past the last area are not part of the config\n",
+                   img->length - end );
+
+    return c.lossy;
+}
+
+int fru_decode_format_by_name( const char *name )
+{
+    if( !strcmp( name, "text" ) )
+        return FRU_DECODE_TEXT;
+    if( !strcmp( name, "json" ) )
+        return FRU_DECODE_JSON;
+    if( !strcmp( name, "ini" ) )
+        return FRU_DECODE_INI;
+    return -1;
+}
+
+/*
+ * Returns 0 if the image parsed cleanly (and for INI, is reproduced
+ * exactly), -1 otherwise; it is printed either way.
+ */
+int fru_decode_image( struct fru_writer *w, const char *name, const uint8_t *data,
+                      int length, int format )
+{
+    struct fru_image img;
+    int ok;
+
+    ok = !fru_read_image( data, length, &img );
+    if( ( format & FRU_DECODE_FORMAT ) == FRU_DECODE_INI )
+        ok = !ini_image( w, name, &img, ok, format & FRU_DECODE_MULTI );
+    else if( format == FRU_DECODE_JSON )
+        json_image( w, name, &img, ok );
+    else
+        text_image( w, name, &img, ok );
+
+    return ok ? 0 : -1;
+}
+
+static void decode_error( struct fru_writer *w, const char *path, const char *error, int format )
+{
+    if( format == FRU_DECODE_JSON )
+    {
+        w_char( w, '{' );
+        w_json_key( w, "file", 1 );
+        w_json_string( w, path, strlen( path ) );
+        w_json_key( w, "error", 0 );
+        w_json_string( w, error, strlen( error ) );
+        w_str( w, "}\n" );
+    }
+    else if( ( format & FRU_DECODE_FORMAT ) == FRU_DECODE_INI )
+        text_line( w, "; lossy: %s %s\n", path, error );
+    else
+        text_line( w, "%s: %s\n", path, error );
+}
+
+int fru_decode_file( struct fru_writer *w, const char *path, int format )
+{
+    const uint8_t *data;
+    struct stat st;
+    int fd, length, done, ret;
+
+    if( ( fd = open( path, O_RDONLY ) ) == -1 || fstat( fd, &st ) )
+    {
+        decode_error( w, path, "cannot open", format );
+        if( fd != -1 )
+            close( fd );
+        return -1;
+    }
+
+    /* Images fit the static buffer, only a huge IUA needs a mapping */
+    length = st.st_size;
+    if( length <= FRU_DECODE_BUFFER )
+    {
+        for( done = 0; done < length; done += ret )
+        {
+            if( ( ret = read( fd, file_buffer + done, length - done ) ) <= 0 )
+                break;
+        }
+        close( fd );
+        if( done < length )
+        {
+            decode_error( w, path, "read error", format );
+            return -1;
+        }
+        return fru_decode_image( w, path, file_buffer, length, format );
+    }
+
+    data = ( const uint8_t * ) mmap( NULL, length, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( data == MAP_FAILED )
+    {
+        decode_error( w, path, "cannot map", format );
+        return -1;
+    }
+    ret = fru_decode_image( w, path, data, length, format );
+    munmap( ( void * ) data, length );
+
+    return ret;
+}
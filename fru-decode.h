@@ -0,0 +1,54 @@
+#ifndef FRU_DECODE_H
+#define FRU_DECODE_H
+
+#include <inttypes.h>
+
+/*
+ * FRU image decoding (-r)
+ *
+ * Every field of every area and every MultiRecord record is printed with
+ * its area, name, type code, raw bytes in hex and decoded text, either for
+ * people (text) or as JSON with one object per image and line (NDJSON), for
+ * feeding an inventory pipeline. The INI format is instead a config that
+ * ipmi-fru-it re-encodes to the same image; with FRU_DECODE_MULTI each image
+ * becomes one FRU of a multi-FRU config, named after its file.
+ *
+ * Nothing is allocated per image: files are read into a static buffer
+ * (mapped if larger), parsed in place by fru_read_image() and written
+ * through a fixed output buffer.
+ */
+
+enum fru_decode_format
+{
+    FRU_DECODE_TEXT = 0,
+    FRU_DECODE_JSON,
+    FRU_DECODE_INI,
+};
+
+#define FRU_DECODE_FORMAT   0xff
+#define FRU_DECODE_MULTI    0x100
+
+#define FRU_WRITER_SIZE     65536
+#define FRU_DECODE_BUFFER   65536
+
+struct fru_writer
+{
+    int         fd;
+    int         pos;
+    int         error;
+    char        buf[FRU_WRITER_SIZE];
+};
+
+void fru_writer_init( struct fru_writer *w, int fd );
+int fru_writer_flush( struct fru_writer *w );
+
+struct fru_field;
+
+int fru_decode_format_by_name( const char *name );
+int fru_decode_field_text( const struct fru_field *f, char *out, int size );
+const char *fru_decode_record_name( uint8_t type_id );
+int fru_decode_image( struct fru_writer *w, const char *name, const uint8_t *data,
+                      int length, int format );
+int fru_decode_file( struct fru_writer *w, const char *path, int format );
+
+#endif
@@ -1,4 +1,8 @@
+#ifndef FRU_DEFS_H
+#define FRU_DEFS_H
+
 #include <inttypes.h>
+#include <stddef.h>
 
 /*
  * Platform Management FRU Information Storage Definition
@@ -98,10 +102,10 @@ struct __attribute__( ( __packed__ ) ) multi_record_header
     uint8_t     record_length;
     uint8_t     record_checksum;
     uint8_t     header_checksum;
-} multi_record_header;
+};
 
 #define UUID_BYTE_LENGTH     16
-#define UUID_STR_LENGTH      49
+#define UUID_STR_LENGTH      36
 
 /* 13. MultiRecord Info Area - Management Access Record Format */
 struct __attribute__( ( __packed__ ) ) management_access_record
@@ -176,8 +180,92 @@ struct __attribute__( ( __packed__ ) ) multirecord_int_record
     uint8_t     record_data[];
 };
 
+/*
+ * 18.1-18.3 Power supply records. Unlike the OEM records above these carry
+ * no padding: record_length is fixed by the spec, and every field offset
+ * is checked at compile time below.
+ */
+struct __attribute__( ( __packed__ ) ) power_supply_information
+{
+    struct multi_record_header record_header;
+    uint16_t    overall_capacity;       /* [11:0] watts */
+    uint16_t    peak_va;                /* 0xffff if not specified */
+    uint8_t     inrush_current;         /* A, 0xff if not specified */
+    uint8_t     inrush_interval;        /* ms */
+    uint16_t    low_input_voltage_1;    /* 10 mV */
+    uint16_t    high_input_voltage_1;
+    uint16_t    low_input_voltage_2;    /* 0 for a single range supply */
+    uint16_t    high_input_voltage_2;
+    uint8_t     low_input_frequency;    /* Hz */
+    uint8_t     high_input_frequency;
+    uint8_t     ac_dropout_tolerance;   /* ms */
+    uint8_t     flags;                  /* PSU_FLAG_* */
+    uint16_t    peak_wattage;           /* [15:12] hold-up seconds, [11:0] watts */
+    uint8_t     combined_voltages;      /* [7:4] voltage 1, [3:0] voltage 2 */
+    uint16_t    combined_wattage;
+    uint8_t     tach_lower_threshold;   /* RPS */
+};
+
+#define PSU_FLAG_PREDICTIVE_FAIL_PIN    0x01
+#define PSU_FLAG_POWER_FACTOR_CORRECTION 0x02
+#define PSU_FLAG_AUTOSWITCH             0x04
+#define PSU_FLAG_HOT_SWAP               0x08
+#define PSU_FLAG_PREDICTIVE_FAIL_TACH   0x10
+
+struct __attribute__( ( __packed__ ) ) dc_output
+{
+    struct multi_record_header record_header;
+    uint8_t     output_information;     /* [7] standby, [3:0] output number */
+    int16_t     nominal_voltage;        /* 10 mV */
+    int16_t     max_negative_deviation;
+    int16_t     max_positive_deviation;
+    uint16_t    ripple_noise;           /* mV */
+    uint16_t    min_current;            /* mA */
+    uint16_t    max_current;
+};
+
+struct __attribute__( ( __packed__ ) ) dc_load
+{
+    struct multi_record_header record_header;
+    uint8_t     output_number;          /* [3:0] */
+    int16_t     nominal_voltage;        /* 10 mV */
+    int16_t     min_voltage;
+    int16_t     max_voltage;
+    uint16_t    ripple_noise;           /* mV */
+    uint16_t    min_current;            /* mA */
+    uint16_t    max_current;
+};
+
+#define PSU_FIELD_AT( type, field, offset ) \
+    _Static_assert( offsetof( struct type, field ) == sizeof( struct multi_record_header ) + offset, \
+                    #type "." #field " is not at record offset " #offset )
+
+_Static_assert( sizeof( struct power_supply_information ) == sizeof( struct multi_record_header ) + 24,
+                "Power Supply Information record data is 24 bytes" );
+PSU_FIELD_AT( power_supply_information, low_input_voltage_1, 6 );
+PSU_FIELD_AT( power_supply_information, low_input_frequency, 14 );
+PSU_FIELD_AT( power_supply_information, flags, 17 );
+PSU_FIELD_AT( power_supply_information, peak_wattage, 18 );
+PSU_FIELD_AT( power_supply_information, combined_voltages, 20 );
+PSU_FIELD_AT( power_supply_information, tach_lower_threshold, 23 );
+
+_Static_assert( sizeof( struct dc_output ) == sizeof( struct multi_record_header ) + 13,
+                "DC Output record data is 13 bytes" );
+PSU_FIELD_AT( dc_output, nominal_voltage, 1 );
+PSU_FIELD_AT( dc_output, ripple_noise, 7 );
+PSU_FIELD_AT( dc_output, max_current, 11 );
+
+_Static_assert( sizeof( struct dc_load ) == sizeof( struct multi_record_header ) + 13,
+                "DC Load record data is 13 bytes" );
+PSU_FIELD_AT( dc_load, nominal_voltage, 1 );
+PSU_FIELD_AT( dc_load, ripple_noise, 7 );
+PSU_FIELD_AT( dc_load, max_current, 11 );
+
 enum fru_multi_record_id
 {
+    MULTI_RECORD_ID_PSU  = 0x00,
+    MULTI_RECORD_ID_DC_OUTPUT = 0x01,
+    MULTI_RECORD_ID_DC_LOAD = 0x02,
     MULTI_RECORD_ID_MAR  = 0x03,
     MULTI_RECORD_ID_VER  = 0xC0,
     MULTI_RECORD_ID_MAC  = 0xC1,
@@ -194,3 +282,5 @@ enum fru_type_code
     TYPE_CODE_ASCII6    = 0x80,
     TYPE_CODE_UNILATIN  = 0xc0,
 };
+
+#endif
@@ -0,0 +1,445 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdarg.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "fru-diff.h"
+#include "fru-decode.h"
+#include "fru-reader.h"
+
+/* A loaded image, the buffer is reused from one file to the next */
+struct image_file
+{
+    uint8_t     *data;
+    int         length;
+    int         size;
+};
+
+/* Difference lines of one image pair */
+struct diff_report
+{
+    const char  *name;
+    char        *buf;
+    int         length;
+    int         size;
+    int         count;
+    int         error;      /* the image could not be read */
+};
+
+struct diff_worker
+{
+    pthread_t               thread;
+    const struct image_file *expected;
+    const struct fru_image  *expected_img;
+    char                    **names;
+    struct diff_report      *reports;
+    int                     num;
+    int                     *next;      /* next dump to compare, shared by all workers */
+};
+
+static int load_file( const char *path, struct image_file *file )
+{
+    struct stat st;
+    int fd, done, ret;
+
+    if( ( fd = open( path, O_RDONLY ) ) == -1 || fstat( fd, &st ) )
+    {
+        perror( "Diff open:" );
+        if( fd != -1 )
+            close( fd );
+        return -1;
+    }
+    if( st.st_size > file->size )
+    {
+        file->size = st.st_size;
+        file->data = ( uint8_t * ) realloc( file->data, file->size );
+    }
+
+    file->length = st.st_size;
+    for( done = 0; done < file->length; done += ret )
+    {
+        if( ( ret = read( fd, file->data + done, file->length - done ) ) <= 0 )
+        {
+            perror( "Diff read:" );
+            close( fd );
+            return -1;
+        }
+    }
+    close( fd );
+
+    return 0;
+}
+
+static void report( struct diff_report *r, const char *fmt, ... )
+    __attribute__(( format( printf, 2, 3 ) ));
+
+static void report( struct diff_report *r, const char *fmt, ... )
+{
+    char line[512];
+    va_list ap;
+    int n;
+
+    va_start( ap, fmt );
+    n = snprintf( line, sizeof( line ), "%s: ", r->name );
+    n += vsnprintf( line + n, sizeof( line ) - n, fmt, ap );
+    va_end( ap );
+    if( n > ( int ) sizeof( line ) - 2 )
+        n = sizeof( line ) - 2;
+    line[n++] = '\n';
+
+    if( r->length + n > r->size )
+    {
+        r->size = ( r->length + n ) * 2;
+        r->buf = ( char * ) realloc( r->buf, r->size );
+    }
+    memcpy( r->buf + r->length, line, n );
+    r->length += n;
+    r->count++;
+}
+
+/* Text, or hex for binary fields, quoted */
+static void field_value( const struct fru_field *f, char *out, int size )
+{
+    char text[256];
+    int n, i;
+
+    if( ( n = fru_decode_field_text( f, text, sizeof( text ) ) ) >= 0 )
+    {
+        snprintf( out, size, f->fixed ? "%.*s" : "\"%.*s\"", n, text );
+        return;
+    }
+    for( n = i = 0; i < f->length && n + 3 < size; i++ )
+        n += snprintf( out + n, size - n, "%02x", f->data[i] );
+    out[n] = '\0';
+}
+
+static void field_label( const struct fru_field *f, char *out, int size )
+{
+    if( f->name )
+        snprintf( out, size, "%s", f->name );
+    else
+        snprintf( out, size, "custom_%d", f->custom + 1 );
+}
+
+static int same_field( const struct fru_field *a, const struct fru_field *b )
+{
+    return a->type == b->type && a->length == b->length &&
+           !memcmp( a->data, b->data, a->length );
+}
+
+/* First differing byte of two ranges, -1 if the common part is equal */
+static int first_difference( const uint8_t *a, const uint8_t *b, int length )
+{
+    int i;
+
+    for( i = 0; i < length; i++ )
+    {
+        if( a[i] != b[i] )
+            return i;
+    }
+    return -1;
+}
+
+static void diff_area( struct diff_report *r, const struct fru_image *a, const struct fru_image *b,
+                       int id )
+{
+    const struct fru_area *x = &a->areas[id], *y = &b->areas[id];
+    const struct fru_field *f, *g;
+    const char *area = fru_area_name( id );
+    char label[32], va[300], vb[300];
+    int i, n, count;
+
+    if( !x->present && !y->present )
+        return;
+    if( !y->present )
+    {
+        report( r, "%s removed", area );
+        return;
+    }
+    if( !x->present )
+    {
+        report( r, "%s added at 0x%x, %d bytes", area, y->offset, y->length );
+        return;
+    }
+
+    if( x->offset != y->offset )
+        report( r, "%s moved 0x%x -> 0x%x", area, x->offset, y->offset );
+    if( x->length == y->length && !memcmp( a->data + x->offset, b->data + y->offset, x->length ) )
+        return;
+
+    if( x->length != y->length )
+        report( r, "%s length %d -> %d", area, x->length, y->length );
+    count = r->count;
+
+    if( id == FRU_AREA_IUA )
+    {
+        n = x->length < y->length ? x->length : y->length;
+        if( ( i = first_difference( a->data + x->offset, b->data + y->offset, n ) ) >= 0 )
+            report( r, "%s data differs from +%d", area, i );
+        return;
+    }
+
+    n = x->num_fields > y->num_fields ? x->num_fields : y->num_fields;
+    for( i = 0; i < n; i++ )
+    {
+        f = i < x->num_fields ? &x->fields[i] : NULL;
+        g = i < y->num_fields ? &y->fields[i] : NULL;
+        field_label( f ? f : g, label, sizeof( label ) );
+        if( !g )
+        {
+            field_value( f, va, sizeof( va ) );
+            report( r, "%s %s removed (%s)", area, label, va );
+        }
+        else if( !f )
+        {
+            field_value( g, vb, sizeof( vb ) );
+            report( r, "%s %s added (%s)", area, label, vb );
+        }
+        else if( !same_field( f, g ) )
+        {
+            field_value( f, va, sizeof( va ) );
+            field_value( g, vb, sizeof( vb ) );
+            report( r, "%s %s: %s -> %s", area, label, va, vb );
+            if( f->type != g->type || ( !f->fixed && f->length != g->length ) )
+                report( r, "%s %s: type/length 0x%02x -> 0x%02x", area, label,
+                        f->type | ( f->length & 0x3f ), g->type | ( g->length & 0x3f ) );
+        }
+    }
+
+    if( a->data[x->cksum_offset] != b->data[y->cksum_offset] || !y->cksum_ok )
+        report( r, "%s checksum 0x%02x -> 0x%02x%s", area, a->data[x->cksum_offset],
+                b->data[y->cksum_offset], y->cksum_ok ? "" : " (bad)" );
+    else if( r->count == count )
+        report( r, "%s padding differs", area );
+}
+
+static void diff_records( struct diff_report *r, const struct fru_image *a,
+                          const struct fru_image *b )
+{
+    const struct fru_record *x, *y;
+    int i, n, at;
+
+    if( a->mia_offset != b->mia_offset && a->num_records && b->num_records )
+        report( r, "mia moved 0x%x -> 0x%x", a->mia_offset, b->mia_offset );
+
+    n = a->num_records > b->num_records ? a->num_records : b->num_records;
+    for( i = 0; i < n; i++ )
+    {
+        x = i < a->num_records ? &a->records[i] : NULL;
+        y = i < b->num_records ? &b->records[i] : NULL;
+        if( !y )
+            report( r, "record %d (%s) removed", i + 1, fru_decode_record_name( x->type_id ) );
+        else if( !x )
+            report( r, "record %d (%s) added, %d bytes", i + 1,
+                    fru_decode_record_name( y->type_id ), y->length );
+        else if( x->type_id != y->type_id )
+            report( r, "record %d type 0x%02x (%s) -> 0x%02x (%s)", i + 1, x->type_id,
+                    fru_decode_record_name( x->type_id ), y->type_id,
+                    fru_decode_record_name( y->type_id ) );
+        else
+        {
+            if( x->length != y->length )
+                report( r, "record %d (%s) length %d -> %d", i + 1,
+                        fru_decode_record_name( x->type_id ), x->length, y->length );
+            at = first_difference( x->data, y->data, x->length < y->length ? x->length : y->length );
+            if( at >= 0 )
+                report( r, "record %d (%s) data differs from +%d", i + 1,
+                        fru_decode_record_name( x->type_id ), at );
+            if( ( x->format_version ^ y->format_version ) & ~MULTI_RECORD_EOL )
+                report( r, "record %d (%s) format version %d -> %d", i + 1,
+                        fru_decode_record_name( x->type_id ),
+                        x->format_version & ~MULTI_RECORD_EOL, y->format_version & ~MULTI_RECORD_EOL );
+            if( !y->cksum_ok )
+                report( r, "record %d (%s) checksum bad", i + 1, fru_decode_record_name( y->type_id ) );
+        }
+    }
+}
+
+/* Returns the number of differences reported */
+static int diff_image( struct diff_report *r, const struct image_file *a,
+                       const struct fru_image *a_img, const struct image_file *b )
+{
+    struct fru_image b_img;
+    int i, ok;
+
+    if( a->length == b->length && !memcmp( a->data, b->data, a->length ) )
+        return 0;
+
+    ok = !fru_read_image( b->data, b->length, &b_img );
+    if( a->length != b->length )
+        report( r, "size %d -> %d", a->length, b->length );
+    if( !ok || !b_img.header_ok )
+    {
+        i = first_difference( a->data, b->data, a->length < b->length ? a->length : b->length );
+        report( r, "not a valid FRU image%s", i >= 0 ? "" : ", same bytes as far as it goes" );
+        if( i >= 0 )
+            report( r, "data differs from 0x%x", i );
+        return r->count;
+    }
+
+    for( i = 0; i < FRU_AREA_NUM; i++ )
+        diff_area( r, a_img, &b_img, i );
+    diff_records( r, a_img, &b_img );
+
+    if( !r->count )
+        report( r, "bytes past the last area differ" );
+    return r->count;
+}
+
+static void *diff_worker_run( void *arg )
+{
+    struct diff_worker *w = ( struct diff_worker * ) arg;
+    struct image_file file;
+    int i;
+
+    memset( &file, 0, sizeof( file ) );
+    while( ( i = __atomic_fetch_add( w->next, 1, __ATOMIC_RELAXED ) ) < w->num )
+    {
+        w->reports[i].name = w->names[i];
+        if( load_file( w->names[i], &file ) )
+        {
+            w->reports[i].error = 1;
+            report( &w->reports[i], "cannot be read" );
+        }
+        else
+            diff_image( &w->reports[i], w->expected, w->expected_img, &file );
+    }
+    free( file.data );
+
+    return NULL;
+}
+
+static int compare_names( const void *a, const void *b )
+{
+    return strcmp( *( char * const * ) a, *( char * const * ) b );
+}
+
+/* Regular files of a directory, sorted */
+static int list_dir( const char *dir, char ***names )
+{
+    char path[PATH_MAX];
+    struct dirent *de;
+    struct stat st;
+    DIR *d;
+    int num;
+
+    if( ( d = opendir( dir ) ) == NULL )
+    {
+        perror( "Diff directory open:" );
+        return -1;
+    }
+    num = 0;
+    *names = NULL;
+    while( ( de = readdir( d ) ) != NULL )
+    {
+        snprintf( path, sizeof( path ), "%s/%s", dir, de->d_name );
+        if( de->d_name[0] == '.' || stat( path, &st ) || !S_ISREG( st.st_mode ) )
+            continue;
+        *names = ( char ** ) realloc( *names, ( num + 1 ) * sizeof( char * ) );
+        ( *names )[num++] = strdup( path );
+    }
+    closedir( d );
+    qsort( *names, num, sizeof( char * ), compare_names );
+
+    return num;
+}
+
+/*
+ * Compare actual, an image or a directory of them, with the expected image
+ * and print the differences. Returns the number of images that differ, -1
+ * if the expected image or any of the actual ones cannot be read.
+ */
+int fru_diff_run( const char *expected, const char *actual, int jobs )
+{
+    struct diff_worker *workers;
+    struct diff_report *reports;
+    struct image_file file;
+    struct fru_image img;
+    struct stat st;
+    char **names;
+    int num, next, differ, errors, is_dir, i;
+
+    memset( &file, 0, sizeof( file ) );
+    if( load_file( expected, &file ) )
+        return -1;
+    if( fru_read_image( file.data, file.length, &img ) || !img.header_ok )
+    {
+        fprintf( stderr, "\nError! %s is not a valid FRU image\n\n", expected );
+        free( file.data );
+        return -1;
+    }
+
+    is_dir = !stat( actual, &st ) && S_ISDIR( st.st_mode );
+    if( is_dir )
+    {
+        if( ( num = list_dir( actual, &names ) ) < 0 )
+        {
+            free( file.data );
+            return -1;
+        }
+    }
+    else
+    {
+        num = 1;
+        names = ( char ** ) malloc( sizeof( char * ) );
+        names[0] = strdup( actual );
+    }
+
+    reports = ( struct diff_report * ) calloc( num ? num : 1, sizeof( *reports ) );
+    if( jobs < 1 )
+        jobs = 1;
+    if( jobs > num )
+        jobs = num ? num : 1;
+    workers = ( struct diff_worker * ) calloc( jobs, sizeof( *workers ) );
+    next = 0;
+    for( i = 0; i < jobs; i++ )
+    {
+        workers[i].expected = &file;
+        workers[i].expected_img = &img;
+        workers[i].names = names;
+        workers[i].reports = reports;
+        workers[i].num = num;
+        workers[i].next = &next;
+    }
+
+    if( jobs == 1 )
+        diff_worker_run( &workers[0] );
+    else
+    {
+        for( i = 0; i < jobs; i++ )
+            pthread_create( &workers[i].thread, NULL, diff_worker_run, &workers[i] );
+        for( i = 0; i < jobs; i++ )
+            pthread_join( workers[i].thread, NULL );
+    }
+
+    differ = errors = 0;
+    for( i = 0; i < num; i++ )
+    {
+        if( reports[i].count )
+        {
+            fwrite( reports[i].buf, 1, reports[i].length, stdout );
+            if( reports[i].error )
+                errors++;
+            else
+                differ++;
+        }
+        free( reports[i].buf );
+        free( names[i] );
+    }
+    if( is_dir )
+        fprintf( stdout, "%d of %d images differ from %s%s\n", differ, num, expected,
+                 errors ? ", some could not be read" : "" );
+
+    free( workers );
+    free( reports );
+    free( names );
+    free( file.data );
+
+    return errors ? -1 : differ;
+}
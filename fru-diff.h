@@ -0,0 +1,20 @@
+#ifndef FRU_DIFF_H
+#define FRU_DIFF_H
+
+/*
+ * Field-level FRU image comparison (--diff)
+ *
+ * Both images are parsed in place by fru_read_image() and compared area by
+ * area. Identical images, and identical areas within differing ones, are
+ * skipped after a single memcmp(); everything else is reported by area and
+ * field name, along with area moves, length and checksum changes and
+ * MultiRecord records that changed, appeared or went away.
+ *
+ * Against a directory, every dump in it is compared with the expected image
+ * on a pool of threads. Only the dumps that differ produce output, in file
+ * name order.
+ */
+
+int fru_diff_run( const char *expected, const char *actual, int jobs );
+
+#endif
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+
+#include "fru-eeprom.h"
+#include "fru-stats.h"
+#include "fru-trace.h"
+
+/* Read up to length bytes at offset 0, returns bytes actually read */
+static int eeprom_read( int fd, uint8_t *buf, int length )
+{
+    int done, ret;
+
+    done = 0;
+    while( done < length )
+    {
+        ret = pread( fd, buf + done, length - done, done );
+        if( ret < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            return -1;
+        }
+        if( ret == 0 )
+            break;
+        done += ret;
+    }
+
+    return done;
+}
+
+static int eeprom_write( int fd, const uint8_t *buf, int length, int offset )
+{
+    int done, ret;
+
+    FRU_TRACE2( eeprom__write, offset, length );
+    done = 0;
+    while( done < length )
+    {
+        ret = pwrite( fd, buf + done, length - done, offset + done );
+        if( ret < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            return -1;
+        }
+        /* at24 accepts nothing past the end of the part */
+        if( ret == 0 )
+        {
+            errno = ENOSPC;
+            return -1;
+        }
+        done += ret;
+    }
+
+    return done;
+}
+
+/*
+ * Size of the part behind fd, 0 if it has none: a sysfs EEPROM node reports
+ * the part size, a block device its capacity, and a plain file just grows.
+ */
+static off_t eeprom_size( int fd )
+{
+    struct statfs sfs;
+    struct stat st;
+    off_t size;
+
+    if( fstat( fd, &st ) )
+        return 0;
+    if( S_ISBLK( st.st_mode ) )
+    {
+        size = lseek( fd, 0, SEEK_END );
+        return size > 0 ? size : 0;
+    }
+    if( S_ISREG( st.st_mode ) && !fstatfs( fd, &sfs ) && sfs.f_type == SYSFS_MAGIC )
+        return st.st_size;
+
+    return 0;
+}
+
+/*
+ * Program image into the EEPROM at path, touching only the pages whose
+ * contents differ from the image, then read everything back and verify.
+ * Adjacent dirty pages are coalesced into a single write.
+ *
+ * Returns 0 on success, -1 on I/O error or verify mismatch.
+ */
+int eeprom_flash( const char *path, const uint8_t *image, int length,
+                  int page_size, struct eeprom_flash_stats *stats )
+{
+    uint8_t *current;
+    off_t size;
+    int fd, cur_len, page, npages, run_start, start, end, i;
+
+    if( page_size <= 0 )
+        page_size = EEPROM_DEFAULT_PAGE_SIZE;
+
+    memset( stats, 0, sizeof( *stats ) );
+    npages = ( length + page_size - 1 ) / page_size;
+    stats->pages_total = npages;
+
+    if( ( fd = open( path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH ) ) == -1 )
+    {
+        perror( "EEPROM open:" );
+        return -1;
+    }
+
+    /* Refuse up front rather than leave a half programmed part */
+    if( ( size = eeprom_size( fd ) ) && length > size )
+    {
+        fprintf( stderr, "\nError! Image of %d bytes is larger than the %lld byte EEPROM\n\n",
+                 length, ( long long ) size );
+        close( fd );
+        return -1;
+    }
+
+    current = ( uint8_t * ) calloc( length, 1 );
+    cur_len = eeprom_read( fd, current, length );
+    if( cur_len < 0 )
+    {
+        perror( "EEPROM read:" );
+        goto err;
+    }
+
+    /* Walk the pages, flushing each run of consecutive dirty pages */
+    run_start = -1;
+    for( page = 0; page <= npages; page++ )
+    {
+        int dirty = 0;
+
+        if( page < npages )
+        {
+            start = page * page_size;
+            end = start + page_size > length ? length : start + page_size;
+            /* Bytes past the current end of the device always count as dirty */
+            dirty = end > cur_len ||
+                    memcmp( current + start, image + start, end - start );
+        }
+
+        if( dirty )
+        {
+            if( run_start < 0 )
+                run_start = page;
+            stats->pages_written++;
+            continue;
+        }
+
+        if( run_start >= 0 )
+        {
+            start = run_start * page_size;
+            end = page * page_size > length ? length : page * page_size;
+            FRU_STATS_START( write_start );
+            if( eeprom_write( fd, image + start, end - start, start ) < 0 )
+            {
+                perror( "EEPROM write:" );
+                goto err;
+            }
+            FRU_STATS_STAGE( "eeprom_write", write_start );
+            stats->bytes_written += end - start;
+            run_start = -1;
+        }
+    }
+
+    FRU_STATS_START( sync_start );
+    if( stats->pages_written && fsync( fd ) && errno != EINVAL )
+    {
+        perror( "EEPROM sync:" );
+        goto err;
+    }
+    FRU_STATS_STAGE( "fsync", sync_start );
+
+    /* Read back and verify the whole image, not only the dirty pages */
+    if( eeprom_read( fd, current, length ) != length ||
+        memcmp( current, image, length ) )
+    {
+        for( i = 0; i < length && current[i] == image[i]; i++ )
+            ;
+        fprintf( stderr, "\nEEPROM verify failed at offset 0x%x\n\n", i );
+        goto err;
+    }
+
+    free( current );
+    close( fd );
+
+    return 0;
+
+err:
+    free( current );
+    close( fd );
+
+    return -1;
+}
@@ -0,0 +1,26 @@
+#ifndef FRU_EEPROM_H
+#define FRU_EEPROM_H
+
+#include <inttypes.h>
+
+/*
+ * Direct EEPROM programming
+ *
+ * The target is anything that can be pread()/pwrite() at an offset: the
+ * Linux at24 sysfs node (/sys/bus/i2c/devices/X-YYYY/eeprom), a loop device
+ * or a plain file used as a stand-in.
+ */
+
+#define EEPROM_DEFAULT_PAGE_SIZE    8
+
+struct eeprom_flash_stats
+{
+    int     pages_total;    /* pages covered by the image */
+    int     pages_written;  /* pages that differed and were rewritten */
+    int     bytes_written;
+};
+
+int eeprom_flash( const char *path, const uint8_t *image, int length,
+                  int page_size, struct eeprom_flash_stats *stats );
+
+#endif
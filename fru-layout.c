@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fru-defs.h"
+#include "fru-layout.h"
+#include "ipmi-fru-it.h"
+#include "fru-reader.h"
+
+struct fru_layout_policy layout_policy = { FRU_LAYOUT_PACKED, 0, 0 };
+
+static int align_up( int value, int align )
+{
+    return ( value + align - 1 ) / align * align;
+}
+
+static int pages_spanned( int start, int length, int page_size )
+{
+    if( !length )
+        return 0;
+    return ( start + length - 1 ) / page_size - start / page_size + 1;
+}
+
+/*
+ * Grow an encoded info area by extra bytes (rounded up to 8) of zero
+ * padding between the end marker and the checksum, so later in-place
+ * updates have room to grow without moving anything else.
+ */
+int fru_pad_info_area( struct fru_area_blob *area, int extra )
+{
+    int new_length;
+    uint8_t *data;
+
+    extra = align_up( extra, 8 );
+    new_length = area->length + extra;
+    if( !extra || new_length / 8 > 0xff )
+        return area->length;
+
+    data = ( uint8_t * ) realloc( area->data, new_length );
+    memset( data + area->length - 1, 0, extra + 1 );
+    data[1] = new_length / 8;
+
+    data[new_length - 1] = get_zero_cksum( data, new_length - 1 );
+
+    area->data = ( char * ) data;
+    area->length = new_length;
+
+    return new_length;
+}
+
+/*
+ * Assign an offset to every present area (data != NULL) and return the
+ * total image length. The last entry is the MultiRecord area and always
+ * stays after the info areas, since its records are walked up to the end
+ * of the list.
+ */
+static int place_areas( struct fru_area_blob *areas, int num,
+                        const struct fru_layout_policy *policy )
+{
+    struct fru_area_blob *mia = &areas[num - 1];
+    int offset, hot_length, i;
+
+    offset = sizeof( struct fru_common_header );
+
+    if( policy->mode == FRU_LAYOUT_PACKED )
+    {
+        for( i = 0; i < num; i++ )
+        {
+            if( !areas[i].data )
+                continue;
+            areas[i].offset = offset;
+            offset += areas[i].length;
+        }
+        return offset;
+    }
+
+    /* Cold info areas first, in their usual order */
+    for( i = 0; i < num - 1; i++ )
+    {
+        if( !areas[i].data || areas[i].hot )
+            continue;
+        areas[i].offset = offset;
+        offset += areas[i].length;
+    }
+
+    hot_length = 0;
+    for( i = 0; i < num; i++ )
+    {
+        if( areas[i].data && areas[i].hot )
+            hot_length += areas[i].length;
+    }
+
+    /*
+     * Start the hot block on a page boundary whenever leaving it where it
+     * is would make it straddle more pages than its size requires.
+     */
+    if( policy->page_size > 0 && hot_length &&
+        pages_spanned( offset, hot_length, policy->page_size ) >
+        ( hot_length + policy->page_size - 1 ) / policy->page_size )
+    {
+        offset = align_up( align_up( offset, policy->page_size ), 8 );
+    }
+
+    for( i = 0; i < num - 1; i++ )
+    {
+        if( !areas[i].data || !areas[i].hot )
+            continue;
+        areas[i].offset = offset;
+        offset += areas[i].length;
+    }
+
+    if( mia->data )
+    {
+        mia->offset = offset;
+        offset += mia->length;
+    }
+
+    return offset;
+}
+
+/*
+ * The common header stores offsets in 8-byte units in one byte. An IUA
+ * large enough to push a later area out of reach is placed after all of
+ * them instead; it still runs up to the end of the image.
+ */
+int fru_layout_areas( struct fru_area_blob *areas, int num,
+                      const struct fru_layout_policy *policy )
+{
+    struct fru_area_blob iua;
+    int offset, i;
+
+    offset = place_areas( areas, num, policy );
+    if( !areas[0].data )
+        return offset;
+    for( i = 1; i < num; i++ )
+    {
+        if( areas[i].data && areas[i].offset > FRU_MAX_AREA_OFFSET )
+            break;
+    }
+    if( i == num )
+        return offset;
+
+    iua = areas[0];
+    areas[0].data = NULL;
+    offset = place_areas( areas, num, policy );
+    areas[0] = iua;
+    areas[0].offset = offset;
+
+    return offset + iua.length;
+}
+
+struct volatile_field
+{
+    int         area;
+    const char  *name;
+};
+
+static const struct volatile_field volatile_fields[] =
+{
+    { FRU_AREA_CIA, "serial_number" },
+    { FRU_AREA_CIA, "asset_tag" },
+    { FRU_AREA_BIA, "mfg_datetime" },
+    { FRU_AREA_BIA, "serial_number" },
+    { FRU_AREA_BIA, "asset_tag" },
+    { FRU_AREA_PIA, "serial_number" },
+    { FRU_AREA_PIA, "asset_tag" },
+};
+
+/* Mark the pages of [start, start + length) and of the checksum byte */
+static int mark_pages( uint8_t *pages, int start, int length, int cksum_offset,
+                       int page_size, int *first, int *last )
+{
+    int count, p;
+
+    count = 0;
+    *first = start / page_size;
+    *last = ( start + length - 1 ) / page_size;
+    for( p = *first; p <= *last; p++ )
+    {
+        count++;
+        pages[p] = 1;
+    }
+
+    if( cksum_offset >= 0 )
+    {
+        p = cksum_offset / page_size;
+        if( p < *first || p > *last )
+            count++;
+        pages[p] = 1;
+        if( p < *first )
+            *first = p;
+        if( p > *last )
+            *last = p;
+    }
+
+    return count;
+}
+
+/*
+ * Print, for every unit-specific field present in the image, how many
+ * EEPROM pages rewriting it costs (its bytes plus the covering checksum).
+ */
+void fru_layout_report( const uint8_t *image, int length, int page_size, FILE *out )
+{
+    struct fru_image img;
+    struct fru_field *f;
+    struct fru_record *rec;
+    uint8_t *pages;
+    int npages, count, total, first, last, i;
+    char name[64];
+
+    if( fru_read_image( image, length, &img ) )
+    {
+        fprintf( out, "\nLayout report: image could not be parsed\n" );
+        return;
+    }
+
+    npages = ( length + page_size - 1 ) / page_size;
+    pages = ( uint8_t * ) calloc( npages, 1 );
+
+    fprintf( out, "\nLayout report (page size %d bytes, image %d bytes, %d pages)\n",
+             page_size, length, npages );
+    fprintf( out, "  %-24s %8s %7s %6s\n", "field", "offset", "length", "pages" );
+
+    for( i = 0; i < ( int )( sizeof( volatile_fields ) / sizeof( volatile_fields[0] ) ); i++ )
+    {
+        f = fru_find_field( &img, volatile_fields[i].area, volatile_fields[i].name );
+        if( !f || !f->length )
+            continue;
+        count = mark_pages( pages, f->data - image, f->length,
+                            img.areas[volatile_fields[i].area].cksum_offset,
+                            page_size, &first, &last );
+        snprintf( name, sizeof( name ), "%s:%s",
+                  fru_area_name( volatile_fields[i].area ), volatile_fields[i].name );
+        fprintf( out, "  %-24s %#8x %7d %6d  (%d-%d)\n", name,
+                 ( unsigned int )( f->data - image ), f->length, count, first, last );
+    }
+
+    for( i = 0; i < img.num_records; i++ )
+    {
+        rec = &img.records[i];
+        if( rec->type_id != MULTI_RECORD_ID_MAR && rec->type_id != MULTI_RECORD_ID_MAC )
+            continue;
+        /* Record data plus both header checksums */
+        count = mark_pages( pages, rec->offset,
+                            sizeof( struct multi_record_header ) + rec->length, -1,
+                            page_size, &first, &last );
+        snprintf( name, sizeof( name ), "record 0x%02x", rec->type_id );
+        fprintf( out, "  %-24s %#8x %7d %6d  (%d-%d)\n", name,
+                 rec->offset, rec->length, count, first, last );
+    }
+
+    total = 0;
+    for( i = 0; i < npages; i++ )
+        total += pages[i];
+    fprintf( out, "  %-24s %8s %7s %6d\n", "all unit-specific fields", "", "", total );
+
+    free( pages );
+}
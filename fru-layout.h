@@ -0,0 +1,50 @@
+#ifndef FRU_LAYOUT_H
+#define FRU_LAYOUT_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+ * Placement of the areas inside the FRU image
+ *
+ * FRU_LAYOUT_PACKED keeps the historical back-to-back IUA, CIA, BIA, PIA,
+ * MultiRecord order. FRU_LAYOUT_HOT_COLD moves the areas that carry per-unit
+ * fields (serial numbers, asset tags, manufacturing date, MACs, UUID) next
+ * to each other at the end of the image and aligns them to the EEPROM page
+ * size, so reprogramming a unit touches as few pages as possible.
+ */
+
+enum fru_layout_mode
+{
+    FRU_LAYOUT_PACKED = 0,
+    FRU_LAYOUT_HOT_COLD,
+};
+
+struct fru_layout_policy
+{
+    int     mode;
+    int     page_size;
+    int     reserve;    /* growth padding appended to every hot info area */
+};
+
+/* Highest offset a common header field can hold */
+#define FRU_MAX_AREA_OFFSET     ( 255 * 8 )
+
+/* One encoded area; the IUA is the first entry, the MultiRecord area the last */
+struct fru_area_blob
+{
+    const char  *section;
+    char        *data;
+    int         length;     /* bytes, multiple of 8 */
+    int         hot;        /* carries per-unit fields */
+    int         offset;     /* assigned by fru_layout_areas() */
+};
+
+extern struct fru_layout_policy layout_policy;
+
+int fru_pad_info_area( struct fru_area_blob *area, int extra );
+int fru_layout_areas( struct fru_area_blob *areas, int num,
+                      const struct fru_layout_policy *policy );
+void fru_layout_report( const uint8_t *image, int length, int page_size, FILE *out );
+
+#endif
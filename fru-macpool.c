@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fru-macpool.h"
+
+struct mac_pool *mac_pool = NULL;
+
+/*
+ * Create a pool file. spec is "OUI" for the whole NIC-specific range of an
+ * OUI, or "OUI:FIRST-LAST" with 24-bit hex NIC parts, e.g. 001122:100000-1fffff.
+ * The file is built aside and renamed into place, so it appears atomically.
+ */
+int mac_pool_create( const char *path, const char *spec )
+{
+    struct mac_pool_state state;
+    unsigned int oui, first, last;
+    char tmp[1024];
+    int fd, n;
+
+    first = 0;
+    last = 0xffffff;
+    n = sscanf( spec, "%6x:%6x-%6x", &oui, &first, &last );
+    if( ( n != 1 && n != 3 ) || strlen( spec ) < 6 || first > last || last > 0xffffff )
+    {
+        fprintf( stderr, "\nInvalid MAC pool \"%s\" (expected OUI or OUI:FIRST-LAST)\n\n", spec );
+        return -1;
+    }
+
+    memset( &state, 0, sizeof( state ) );
+    memcpy( state.magic, MAC_POOL_MAGIC, sizeof( state.magic ) );
+    state.base = ( ( uint64_t ) oui << 24 ) | first;
+    state.limit = ( ( uint64_t ) oui << 24 ) + last + 1;
+    state.next = state.base;
+
+    snprintf( tmp, sizeof( tmp ), "%s.%d.tmp", path, ( int ) getpid() );
+    if( ( fd = open( tmp, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH ) ) == -1 )
+    {
+        perror( "MAC pool create:" );
+        return -1;
+    }
+    if( write( fd, &state, sizeof( state ) ) != sizeof( state ) || fsync( fd ) )
+    {
+        perror( "MAC pool write:" );
+        close( fd );
+        unlink( tmp );
+        return -1;
+    }
+    close( fd );
+
+    /* Never clobber a pool that is already handing out addresses */
+    if( link( tmp, path ) )
+    {
+        perror( "MAC pool create:" );
+        unlink( tmp );
+        return -1;
+    }
+    unlink( tmp );
+
+    return 0;
+}
+
+struct mac_pool *mac_pool_open( const char *path, uint64_t chunk )
+{
+    struct mac_pool *pool;
+    struct stat st;
+    char journal[1024];
+
+    pool = ( struct mac_pool * ) calloc( 1, sizeof( *pool ) );
+    pool->chunk = chunk;
+
+    if( ( pool->fd = open( path, O_RDWR ) ) == -1 )
+    {
+        perror( "MAC pool open:" );
+        free( pool );
+        return NULL;
+    }
+    if( fstat( pool->fd, &st ) || st.st_size < ( off_t ) sizeof( struct mac_pool_state ) )
+    {
+        fprintf( stderr, "\n%s is not a MAC pool\n\n", path );
+        goto err;
+    }
+
+    pool->state = ( struct mac_pool_state * ) mmap( NULL, sizeof( struct mac_pool_state ),
+                  PROT_READ | PROT_WRITE, MAP_SHARED, pool->fd, 0 );
+    if( pool->state == MAP_FAILED )
+    {
+        perror( "MAC pool mmap:" );
+        goto err;
+    }
+    if( memcmp( pool->state->magic, MAC_POOL_MAGIC, sizeof( pool->state->magic ) ) )
+    {
+        fprintf( stderr, "\n%s is not a MAC pool\n\n", path );
+        munmap( pool->state, sizeof( struct mac_pool_state ) );
+        goto err;
+    }
+
+    snprintf( journal, sizeof( journal ), "%s.journal", path );
+    pool->journal_fd = open( journal, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH );
+    if( pool->journal_fd == -1 )
+    {
+        perror( "MAC pool journal:" );
+        munmap( pool->state, sizeof( struct mac_pool_state ) );
+        goto err;
+    }
+
+    return pool;
+
+err:
+    close( pool->fd );
+    free( pool );
+    return NULL;
+}
+
+static void journal( struct mac_pool *pool, char op, uint64_t first, uint64_t count )
+{
+    char line[64];
+    int len;
+
+    /* One write per line: O_APPEND keeps lines from different writers whole */
+    len = snprintf( line, sizeof( line ), "%c %d %012llx %llu\n", op, ( int ) getpid(),
+                    ( unsigned long long ) first, ( unsigned long long ) count );
+    if( write( pool->journal_fd, line, len ) != len )
+        perror( "MAC pool journal:" );
+}
+
+/* Hand the unused rest of a block back, possible only while it is on top */
+void mac_pool_release( struct mac_pool *pool, struct mac_block *block )
+{
+    uint64_t expected = block->end;
+
+    if( block->end > block->cur &&
+        __atomic_compare_exchange_n( &pool->state->next, &expected, block->cur, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) )
+        journal( pool, 'R', block->cur, block->end - block->cur );
+    block->cur = block->end = 0;
+}
+
+/*
+ * Allocate count consecutive addresses, returns 0 or -1 when the pool is
+ * exhausted. block may be NULL when several threads share the pool without
+ * blocks of their own. A chunk is cut short at the limit and at what the
+ * block still wants, so the last addresses of the pool are not stranded
+ * in one worker's block while the others run dry.
+ */
+int mac_pool_alloc( struct mac_pool *pool, struct mac_block *block,
+                    uint64_t count, uint64_t *first )
+{
+    struct mac_block single = { 0, 0, 0 };
+    uint64_t reserve, start, limit;
+
+    /* Without a block, take exactly count straight from the shared counter */
+    if( !block )
+        block = &single;
+
+    if( block->end - block->cur < count )
+    {
+        mac_pool_release( pool, block );
+
+        limit = pool->state->limit;
+        start = __atomic_load_n( &pool->state->next, __ATOMIC_SEQ_CST );
+        do
+        {
+            if( start > limit || limit - start < count )
+            {
+                fprintf( stderr, "\nMAC pool exhausted\n\n" );
+                return -1;
+            }
+            reserve = pool->chunk > count && block != &single ? pool->chunk : count;
+            if( block->want && reserve > block->want )
+                reserve = block->want > count ? block->want : count;
+            if( reserve > limit - start )
+                reserve = limit - start;
+        } while( !__atomic_compare_exchange_n( &pool->state->next, &start, start + reserve, 0,
+                                               __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST ) );
+        block->cur = start;
+        block->end = start + reserve;
+        journal( pool, 'A', start, reserve );
+    }
+
+    *first = block->cur;
+    block->cur += count;
+    block->want = block->want > count ? block->want - count : 0;
+
+    return 0;
+}
+
+static void mac_to_bytes( uint64_t mac, uint8_t *bytes )
+{
+    int i;
+
+    for( i = 0; i < MAC_ADDRESS_BYTE_LENGTH; i++ )
+        bytes[i] = mac >> ( 40 - 8 * i );
+}
+
+/*
+ * Fill the three base addresses of a MAC record from one allocation sized
+ * by its counts: host addresses first, then BMC, then switch.
+ */
+int mac_pool_assign( struct mac_pool *pool, struct mac_block *block,
+                     struct mac_address *mac )
+{
+    uint64_t first, host, bmc, sw;
+
+    host = mac->host_mac_address_count;
+    bmc = mac->bmc_mac_address_count;
+    sw = mac->switch_mac_address_count;
+    if( mac_pool_alloc( pool, block, host + bmc + sw, &first ) )
+        return -1;
+
+    mac_to_bytes( host ? first : 0, mac->host_base_mac_address );
+    mac_to_bytes( bmc ? first + host : 0, mac->bmc_base_mac_address );
+    mac_to_bytes( sw ? first + host + bmc : 0, mac->switch_base_mac_address );
+
+    return 0;
+}
+
+void mac_pool_close( struct mac_pool *pool )
+{
+    mac_pool_release( pool, &pool->local );
+    msync( pool->state, sizeof( struct mac_pool_state ), MS_SYNC );
+    munmap( pool->state, sizeof( struct mac_pool_state ) );
+    close( pool->journal_fd );
+    close( pool->fd );
+    free( pool );
+}
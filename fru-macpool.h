@@ -0,0 +1,67 @@
+#ifndef FRU_MACPOOL_H
+#define FRU_MACPOOL_H
+
+#include <inttypes.h>
+
+#include "fru-defs.h"
+
+/*
+ * MAC address pool
+ *
+ * The pool file holds the address range and a next-free counter. It is
+ * mapped MAP_SHARED and the counter is advanced with an atomic fetch-add,
+ * so parallel workers and separate processes can allocate from the same
+ * pool without locking. Every reservation taken from the shared counter is
+ * appended to "<pool>.journal" with a single O_APPEND write.
+ *
+ * A caller may reserve a chunk of addresses at once and hand out units
+ * from it through a private mac_block, so a batch touches the shared
+ * counter and the journal once per chunk rather than once per unit. What
+ * is left of a block is given back if nobody allocated behind it.
+ */
+
+#define MAC_POOL_MAGIC          "FRUMACP1"
+#define MAC_POOL_BATCH_CHUNK    4096
+
+struct mac_pool_state
+{
+    char        magic[8];
+    uint64_t    base;       /* first address, the OUI is the top 24 bits */
+    uint64_t    limit;      /* one past the last address */
+    uint64_t    next;       /* next free address */
+};
+
+/*
+ * Addresses reserved from the pool but not handed out yet: [cur, end).
+ * want, when set, is how many more addresses the owner expects to take;
+ * no chunk is larger, so parallel workers leave the rest of a nearly full
+ * pool to each other.
+ */
+struct mac_block
+{
+    uint64_t                cur;
+    uint64_t                end;
+    uint64_t                want;
+};
+
+struct mac_pool
+{
+    int                     fd;
+    int                     journal_fd;
+    struct mac_pool_state   *state;
+    uint64_t                chunk;      /* addresses reserved per counter update */
+    struct mac_block        local;      /* block of the main thread */
+};
+
+extern struct mac_pool *mac_pool;
+
+int mac_pool_create( const char *path, const char *spec );
+struct mac_pool *mac_pool_open( const char *path, uint64_t chunk );
+int mac_pool_alloc( struct mac_pool *pool, struct mac_block *block,
+                    uint64_t count, uint64_t *first );
+void mac_pool_release( struct mac_pool *pool, struct mac_block *block );
+int mac_pool_assign( struct mac_pool *pool, struct mac_block *block,
+                     struct mac_address *mac );
+void mac_pool_close( struct mac_pool *pool );
+
+#endif
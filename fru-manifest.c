@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fru-defs.h"
+#include "fru-reader.h"
+#include "fru-manifest.h"
+
+const char *fru_type_code_name( uint8_t type )
+{
+    switch( type & 0xc0 )
+    {
+        case TYPE_CODE_BINARY:
+            return "binary";
+        case TYPE_CODE_BCDPLUS:
+            return "bcdplus";
+        case TYPE_CODE_ASCII6:
+            return "ascii6";
+        default:
+            return "ascii8";
+    }
+}
+
+/*
+ * Name of the n-th custom field of an area: custom fields are emitted for
+ * the non-predefined, non-empty keys of the section, in config order.
+ */
+static const char *custom_key( dictionary *ini, int area, int n )
+{
+    const char *section = fru_area_name( area );
+    char **sec_keys, *key, *str_data;
+    const char *found;
+    int num_keys, i, len;
+
+    found = NULL;
+    num_keys = iniparser_getsecnkeys( ini, section );
+    sec_keys = iniparser_getseckeys( ini, section );
+    len = strlen( section ) + 1;
+
+    for( i = 0; i < num_keys && !found; i++ )
+    {
+        key = sec_keys[i];
+        if( fru_is_predefined_key( area, key + len ) )
+            continue;
+        str_data = iniparser_getstring( ini, key, NULL );
+        if( !str_data || !strlen( str_data ) )
+            continue;
+        if( !n-- )
+            found = key + len;
+    }
+
+    free( sec_keys );
+
+    return found;
+}
+
+int write_fru_manifest( const char *path, dictionary *ini,
+                        const uint8_t *image, int length )
+{
+    struct fru_image img;
+    struct fru_area *area;
+    struct fru_field *f;
+    struct fru_record *rec;
+    const char *key, *size_key;
+    char full_key[128];
+    int reserved, first, i, j;
+    FILE *out;
+
+    if( fru_read_image( image, length, &img ) )
+    {
+        fprintf( stderr, "\nManifest: generated image could not be parsed\n\n" );
+        return -1;
+    }
+
+    if( ( out = fopen( path, "w" ) ) == NULL )
+    {
+        perror( "Manifest open:" );
+        return -1;
+    }
+
+    fprintf( out, "{\n  \"image_length\": %d,\n", length );
+    fprintf( out, "  \"header\": { \"offset\": 0, \"checksum_offset\": %d },\n",
+             ( int ) sizeof( struct fru_common_header ) - 1 );
+
+    fprintf( out, "  \"areas\": [" );
+    first = 1;
+    for( i = 0; i < FRU_AREA_NUM; i++ )
+    {
+        area = &img.areas[i];
+        if( !area->present )
+            continue;
+        fprintf( out, "%s\n    { \"area\": \"%s\", \"offset\": %d, \"length\": %d, "
+                 "\"checksum_offset\": %d }",
+                 first ? "" : ",", fru_area_name( i ), area->offset, area->length,
+                 area->cksum_offset );
+        first = 0;
+    }
+    fprintf( out, "\n  ],\n" );
+
+    fprintf( out, "  \"fields\": [" );
+    first = 1;
+    for( i = FRU_AREA_CIA; i < FRU_AREA_NUM; i++ )
+    {
+        area = &img.areas[i];
+        for( j = 0; j < area->num_fields; j++ )
+        {
+            f = &area->fields[j];
+            key = f->name ? f->name : custom_key( ini, i, f->custom );
+            reserved = -1;
+            if( f->name && ( size_key = fru_field_size_key( i, f->name ) ) != NULL )
+            {
+                snprintf( full_key, sizeof( full_key ), "%s:%s", fru_area_name( i ), size_key );
+                reserved = iniparser_getint( ini, full_key, -1 );
+                if( reserved != -1 )
+                    reserved &= 0x3f;
+            }
+
+            fprintf( out, "%s\n    { \"area\": \"%s\", \"key\": \"%s\", ",
+                     first ? "" : ",", fru_area_name( i ), key ? key : "" );
+            if( f->fixed )
+                fprintf( out, "\"type_length_offset\": null, " );
+            else
+                fprintf( out, "\"type_length_offset\": %d, ", f->offset );
+            fprintf( out, "\"offset\": %d, \"length\": %d, ",
+                     ( int )( f->data - image ), f->length );
+            if( reserved >= 0 )
+                fprintf( out, "\"reserved\": %d, ", reserved );
+            else
+                fprintf( out, "\"reserved\": null, " );
+            fprintf( out, "\"encoding\": \"%s\", \"checksum_offset\": %d }",
+                     fru_type_code_name( f->type ), area->cksum_offset );
+            first = 0;
+        }
+    }
+    fprintf( out, "\n  ],\n" );
+
+    fprintf( out, "  \"records\": [" );
+    for( i = 0; i < img.num_records; i++ )
+    {
+        rec = &img.records[i];
+        fprintf( out, "%s\n    { \"type_id\": %d, \"offset\": %d, \"data_offset\": %d, "
+                 "\"length\": %d, \"record_checksum_offset\": %d, "
+                 "\"header_checksum_offset\": %d }",
+                 i ? "," : "", rec->type_id, rec->offset,
+                 ( int )( rec->data - image ), rec->length,
+                 rec->offset + 3, rec->offset + 4 );
+    }
+    fprintf( out, "\n  ]\n}\n" );
+
+    if( fclose( out ) )
+    {
+        perror( "Manifest write:" );
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef FRU_MANIFEST_H
+#define FRU_MANIFEST_H
+
+#include <inttypes.h>
+
+#include "iniparser.h"
+
+/*
+ * Field slot manifest
+ *
+ * A JSON description of where every field of a generated image lives, so
+ * factory patchers can update values in place without re-encoding.
+ */
+
+const char *fru_type_code_name( uint8_t type );
+int write_fru_manifest( const char *path, dictionary *ini,
+                        const uint8_t *image, int length );
+
+#endif
@@ -0,0 +1,477 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fru-defs.h"
+#include "fru-patch.h"
+#include "ipmi-fru-it.h"
+
+#define FRU_FIELD_MAX_LENGTH    0x3f
+
+struct patch_map
+{
+    int         fd;
+    uint8_t     *data;
+    int         length;
+    long        page_size;
+    uint8_t     *dirty;     /* one flag per page of the mapping */
+};
+
+static int hex_value( char c )
+{
+    if( c >= '0' && c <= '9' )
+        return c - '0';
+    c = tolower( c );
+    if( c >= 'a' && c <= 'f' )
+        return c - 'a' + 10;
+    return -1;
+}
+
+static int bcdplus_value( char c )
+{
+    if( c >= '0' && c <= '9' )
+        return c - '0';
+    switch( c )
+    {
+        case ' ':
+            return 0x0a;
+        case '-':
+            return 0x0b;
+        case '.':
+            return 0x0c;
+        default:
+            return -1;
+    }
+}
+
+/*
+ * Encode len bytes of value with the given type code. Returns the number of
+ * bytes the encoding needs, or -1 if value cannot be represented. out is
+ * only written when given and the encoding fits capacity; the rest of the
+ * slot is padded the way the generator pads it (spaces for 8-bit ASCII,
+ * zero otherwise).
+ */
+int fru_encode_value( uint8_t type, const char *value, int len, uint8_t *out, int capacity )
+{
+    int needed, i, v;
+    uint8_t c[4];
+
+    switch( type & 0xc0 )
+    {
+        case TYPE_CODE_UNILATIN:
+            /* Like the generator, never a one-byte field: C1h ends the fields */
+            needed = len == 1 ? 2 : len;
+            if( needed > capacity || !out )
+                return needed;
+            memcpy( out, value, len );
+            memset( out + len, 0x20, capacity - len );
+            return needed;
+
+        case TYPE_CODE_ASCII6:
+            needed = ( len * 6 + 7 ) / 8;
+            if( needed > capacity || !out )
+                return needed;
+            memset( out, 0, capacity );
+            for( i = 0; i < len; i += 4 )
+            {
+                /* Same packing as pack_ascii6() */
+                memset( c, 0, sizeof( c ) );
+                for( v = 0; v < 4 && i + v < len; v++ )
+                    c[v] = ( value[i + v] - 0x20 ) & 0x3f;
+                out[i / 4 * 3] = c[0] | ( c[1] << 6 );
+                if( i / 4 * 3 + 1 < needed )
+                    out[i / 4 * 3 + 1] = ( c[1] >> 2 ) | ( c[2] << 4 );
+                if( i / 4 * 3 + 2 < needed )
+                    out[i / 4 * 3 + 2] = ( c[2] >> 4 ) | ( c[3] << 2 );
+            }
+            return needed;
+
+        case TYPE_CODE_BCDPLUS:
+            needed = ( len + 1 ) / 2;
+            for( i = 0; i < len; i++ )
+            {
+                if( bcdplus_value( value[i] ) < 0 )
+                    return -1;
+            }
+            if( needed > capacity || !out )
+                return needed;
+            memset( out, 0, capacity );
+            for( i = 0; i < len; i++ )
+                out[i / 2] |= bcdplus_value( value[i] ) << ( i & 1 ? 0 : 4 );
+            /* An odd digit count is completed with a space */
+            if( len & 1 )
+                out[len / 2] |= 0x0a;
+            return needed;
+
+        default:
+            /* Binary fields are given as hex digits */
+            if( len & 1 )
+                return -1;
+            needed = len / 2;
+            for( i = 0; i < len; i++ )
+            {
+                if( hex_value( value[i] ) < 0 )
+                    return -1;
+            }
+            if( needed > capacity || !out )
+                return needed;
+            memset( out, 0, capacity );
+            for( i = 0; i < needed; i++ )
+                out[i] = ( hex_value( value[2 * i] ) << 4 ) | hex_value( value[2 * i + 1] );
+            return needed;
+    }
+}
+
+void fru_slot_from_field( struct fru_slot *slot, const struct fru_image *img,
+                          int area, const struct fru_field *f )
+{
+    slot->data_offset = f->data - img->data;
+    slot->capacity = f->length;
+    slot->type = f->type;
+    slot->fixed = f->fixed;
+    slot->cksum_offset = img->areas[area].cksum_offset;
+}
+
+/*
+ * Rewrite a slot in place and fix its checksum incrementally.
+ * Returns the number of bytes changed, -1 if the value does not fit.
+ */
+int fru_slot_write( uint8_t *image, const struct fru_slot *slot, const char *value, int len )
+{
+    uint8_t buf[FRU_FIELD_MAX_LENGTH + 1];
+    uint8_t *dst = image + slot->data_offset;
+    int delta, changed, i;
+    unsigned long num;
+    char *end;
+
+    if( slot->fixed )
+    {
+        /* Fixed fields (chassis type, language, mfg date) are little-endian numbers */
+        num = strtoul( value, &end, 0 );
+        if( *end || ( slot->capacity < 4 && num >> ( slot->capacity * 8 ) ) )
+            return -1;
+        for( i = 0; i < slot->capacity; i++ )
+            buf[i] = num >> ( i * 8 );
+    }
+    else
+    {
+        i = fru_encode_value( slot->type, value, len, buf, slot->capacity );
+        if( i < 0 || i > slot->capacity )
+            return -1;
+    }
+
+    delta = changed = 0;
+    for( i = 0; i < slot->capacity; i++ )
+    {
+        if( dst[i] == buf[i] )
+            continue;
+        delta += dst[i] - buf[i];
+        dst[i] = buf[i];
+        changed++;
+    }
+    image[slot->cksum_offset] += delta;
+
+    return changed;
+}
+
+static void mark_dirty( struct patch_map *m, int offset, int length )
+{
+    int page;
+
+    for( page = offset / m->page_size; page <= ( offset + length - 1 ) / m->page_size; page++ )
+        m->dirty[page] = 1;
+}
+
+/* Grow the backing file and the mapping */
+static int grow_map( struct patch_map *m, int length )
+{
+    uint8_t *data;
+    int old_pages, new_pages;
+
+    if( length <= m->length )
+        return 0;
+
+    if( ftruncate( m->fd, length ) )
+    {
+        perror( "Image resize:" );
+        return -1;
+    }
+    data = ( uint8_t * ) mremap( m->data, m->length, length, MREMAP_MAYMOVE );
+    if( data == MAP_FAILED )
+    {
+        perror( "Image remap:" );
+        return -1;
+    }
+
+    old_pages = ( m->length + m->page_size - 1 ) / m->page_size;
+    new_pages = ( length + m->page_size - 1 ) / m->page_size;
+    m->dirty = ( uint8_t * ) realloc( m->dirty, new_pages );
+    memset( m->dirty + old_pages, 0, new_pages - old_pages );
+    m->data = data;
+    m->length = length;
+
+    return 0;
+}
+
+static void fix_header_checksum( uint8_t *h, int length )
+{
+    h[length - 1] = get_zero_cksum( h, length - 1 );
+}
+
+/*
+ * Rebuild the area around a field that outgrew its slot, moving as little
+ * as possible. Returns the new area offset, -1 on error.
+ */
+static int relayout_field( struct patch_map *m, struct fru_image *img, int area_id,
+                           struct fru_field *f, const char *value, int len )
+{
+    struct fru_area *area = &img->areas[area_id];
+    struct fru_common_header *fch;
+    uint8_t buf[256 * 8];
+    uint8_t type = f->type;
+    int head, tail, needed, used, new_length, next, offset, i;
+
+    /* Empty slots are written as 8-bit ASCII, like the generator does */
+    if( type == TYPE_CODE_BINARY && !f->length )
+        type = TYPE_CODE_UNILATIN;
+
+    needed = fru_encode_value( type, value, len, NULL, 0 );
+    if( needed < 0 || needed > FRU_FIELD_MAX_LENGTH )
+    {
+        fprintf( stderr, "\nValue \"%s\" cannot be encoded in a FRU field\n\n", value );
+        return -1;
+    }
+
+    head = f->offset - area->offset;
+    tail = area->end_offset + 1 - ( f->offset + 1 + f->length );
+    used = head + 1 + needed + tail;
+    new_length = get_aligned_size( used + 1, 8 );
+    if( new_length < area->length )
+        new_length = area->length;
+    if( new_length / 8 > 0xff )
+    {
+        fprintf( stderr, "\nArea %s would exceed the maximum area length\n\n",
+                 fru_area_name( area_id ) );
+        return -1;
+    }
+
+    memset( buf, 0, new_length );
+    memcpy( buf, img->data + area->offset, head );
+    buf[head] = type | needed;
+    fru_encode_value( type, value, len, buf + head + 1, needed );
+    memcpy( buf + head + 1 + needed, f->data + f->length, tail );
+    buf[1] = new_length / 8;
+    fix_header_checksum( buf, new_length );
+
+    /* Whatever follows the area bounds in-place growth */
+    next = m->length;
+    for( i = 0; i < FRU_AREA_NUM; i++ )
+    {
+        if( img->areas[i].present && img->areas[i].offset > area->offset &&
+            img->areas[i].offset < next )
+            next = img->areas[i].offset;
+    }
+    if( img->num_records && img->mia_offset > area->offset && img->mia_offset < next )
+        next = img->mia_offset;
+
+    offset = area->offset;
+    if( next == m->length || area->offset + new_length <= next )
+    {
+        /* Fits in its own padding, in the gap behind it, or at the end */
+        if( grow_map( m, offset + new_length ) )
+            return -1;
+    }
+    else
+    {
+        /* Move the area behind everything else */
+        offset = get_aligned_size( img->used_length, 8 );
+        if( offset / 8 > 0xff )
+        {
+            fprintf( stderr, "\nNo room to relocate area %s\n\n", fru_area_name( area_id ) );
+            return -1;
+        }
+        if( grow_map( m, offset + new_length ) )
+            return -1;
+
+        fch = ( struct fru_common_header * ) m->data;
+        switch( area_id )
+        {
+            case FRU_AREA_CIA:
+                fch->chassis_info_offset = offset / 8;
+                break;
+            case FRU_AREA_BIA:
+                fch->board_info_offset = offset / 8;
+                break;
+            default:
+                fch->product_info_offset = offset / 8;
+                break;
+        }
+        fix_header_checksum( m->data, sizeof( struct fru_common_header ) );
+        mark_dirty( m, 0, sizeof( struct fru_common_header ) );
+
+        /* Terminate the MultiRecord list so the moved area is not walked as records */
+        if( img->num_records )
+        {
+            uint8_t *h = m->data + img->records[img->num_records - 1].offset;
+
+            if( !( h[1] & MULTI_RECORD_EOL ) )
+            {
+                h[1] |= MULTI_RECORD_EOL;
+                fix_header_checksum( h, sizeof( struct multi_record_header ) );
+                mark_dirty( m, h - m->data, sizeof( struct multi_record_header ) );
+            }
+        }
+    }
+
+    memcpy( m->data + offset, buf, new_length );
+    mark_dirty( m, offset, new_length );
+
+    return offset;
+}
+
+/* Apply one "area:key=value" assignment */
+static int patch_one( struct patch_map *m, const char *set )
+{
+    struct fru_image img;
+    struct fru_field *f;
+    struct fru_slot slot;
+    char area_name[8], key[64];
+    const char *colon, *eq, *value;
+    int area, changed, offset, len;
+
+    colon = strchr( set, ':' );
+    eq = strchr( set, '=' );
+    if( !colon || !eq || eq < colon ||
+        colon - set >= ( int ) sizeof( area_name ) || eq - colon - 1 >= ( int ) sizeof( key ) )
+    {
+        fprintf( stderr, "\nInvalid assignment \"%s\" (expected area:key=value)\n\n", set );
+        return -1;
+    }
+    memcpy( area_name, set, colon - set );
+    area_name[colon - set] = '\0';
+    memcpy( key, colon + 1, eq - colon - 1 );
+    key[eq - colon - 1] = '\0';
+    value = eq + 1;
+    len = strlen( value );
+
+    /* Offsets may have moved after the previous assignment, walk again */
+    fru_read_image( m->data, m->length, &img );
+    if( !img.header_ok )
+    {
+        fprintf( stderr, "\nNot a FRU image (bad common header)\n\n" );
+        return -1;
+    }
+
+    area = fru_area_by_name( area_name );
+    f = fru_find_field( &img, area, key );
+    if( !f )
+    {
+        fprintf( stderr, "\nField %s:%s not found in image\n\n", area_name, key );
+        return -1;
+    }
+    if( !img.areas[area].cksum_ok )
+        fprintf( stderr, "Warning: %s checksum was already invalid\n", area_name );
+
+    fru_slot_from_field( &slot, &img, area, f );
+    changed = fru_slot_write( m->data, &slot, value, len );
+    if( changed >= 0 )
+    {
+        if( changed )
+        {
+            mark_dirty( m, slot.data_offset, slot.capacity );
+            mark_dirty( m, slot.cksum_offset, 1 );
+        }
+        fprintf( stdout, "%s:%s: patched in place (%d bytes changed)\n", area_name, key, changed );
+        return 0;
+    }
+    if( f->fixed )
+    {
+        fprintf( stderr, "\nValue \"%s\" out of range for %s:%s\n\n", value, area_name, key );
+        return -1;
+    }
+
+    offset = relayout_field( m, &img, area, f, value, len );
+    if( offset < 0 )
+        return -1;
+    if( offset == img.areas[area].offset )
+        fprintf( stdout, "%s:%s: slot grown, %s area rewritten in place\n",
+                 area_name, key, area_name );
+    else
+        fprintf( stdout, "%s:%s: slot grown, %s area moved from 0x%x to 0x%x\n",
+                 area_name, key, area_name, img.areas[area].offset, offset );
+
+    return 0;
+}
+
+/*
+ * Patch an existing FRU image file through a shared mapping and flush only
+ * the pages that were actually modified.
+ */
+int fru_patch_file( const char *path, char **sets, int num_sets )
+{
+    struct patch_map m;
+    struct stat st;
+    int ret, start, page, npages, i;
+
+    memset( &m, 0, sizeof( m ) );
+    if( ( m.fd = open( path, O_RDWR ) ) == -1 )
+    {
+        perror( "Image open:" );
+        return -1;
+    }
+    if( fstat( m.fd, &st ) || st.st_size < ( off_t ) sizeof( struct fru_common_header ) )
+    {
+        fprintf( stderr, "\n%s is too small to be a FRU image\n\n", path );
+        close( m.fd );
+        return -1;
+    }
+
+    m.length = st.st_size;
+    m.page_size = sysconf( _SC_PAGESIZE );
+    m.data = ( uint8_t * ) mmap( NULL, m.length, PROT_READ | PROT_WRITE, MAP_SHARED, m.fd, 0 );
+    if( m.data == MAP_FAILED )
+    {
+        perror( "Image mmap:" );
+        close( m.fd );
+        return -1;
+    }
+    m.dirty = ( uint8_t * ) calloc( ( m.length + m.page_size - 1 ) / m.page_size, 1 );
+
+    ret = 0;
+    for( i = 0; i < num_sets && !ret; i++ )
+        ret = patch_one( &m, sets[i] );
+
+    /* Flush each run of dirty pages */
+    npages = ( m.length + m.page_size - 1 ) / m.page_size;
+    start = -1;
+    for( page = 0; page <= npages; page++ )
+    {
+        if( page < npages && m.dirty[page] )
+        {
+            if( start < 0 )
+                start = page;
+            continue;
+        }
+        if( start >= 0 )
+        {
+            if( msync( m.data + start * m.page_size, ( page - start ) * m.page_size, MS_SYNC ) )
+            {
+                perror( "Image msync:" );
+                ret = -1;
+            }
+            start = -1;
+        }
+    }
+
+    munmap( m.data, m.length );
+    free( m.dirty );
+    close( m.fd );
+
+    return ret;
+}
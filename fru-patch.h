@@ -0,0 +1,33 @@
+#ifndef FRU_PATCH_H
+#define FRU_PATCH_H
+
+#include <inttypes.h>
+
+#include "fru-reader.h"
+
+/*
+ * In-place field updates of encoded FRU images
+ *
+ * A value that fits the existing slot is re-encoded into it with the same
+ * type code and the covering checksum is adjusted incrementally. Values
+ * that do not fit make the owning area grow: first into its own padding,
+ * then into free space behind it, and only as a last resort the area is
+ * moved to the end of the image.
+ */
+
+struct fru_slot
+{
+    int         data_offset;
+    int         capacity;       /* bytes available in the slot */
+    uint8_t     type;           /* TYPE_CODE_* of the slot */
+    int         fixed;          /* fixed field, value is a number */
+    int         cksum_offset;
+};
+
+void fru_slot_from_field( struct fru_slot *slot, const struct fru_image *img,
+                          int area, const struct fru_field *f );
+int fru_encode_value( uint8_t type, const char *value, int len, uint8_t *out, int capacity );
+int fru_slot_write( uint8_t *image, const struct fru_slot *slot, const char *value, int len );
+int fru_patch_file( const char *path, char **sets, int num_sets );
+
+#endif
@@ -0,0 +1,367 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fru-reader.h"
+#include "ipmi-fru-it.h"
+
+static const char *area_names[FRU_AREA_NUM] = { "iua", "cia", "bia", "pia" };
+
+/* Predefined fields in the order the generator emits them, see gen_cia() etc. */
+static const struct fru_field_def cia_fields[] =
+{
+    { "part_number",    "part_number_size" },
+    { "serial_number",  "serial_number_size" },
+    { "product_name",   "product_name_size" },
+    { "sku_id",         "sku_id_size" },
+    { "manufacturer",   "manufacturer_size" },
+    { "version",        "version_size" },
+    { "asset_tag",      "asset_tag_size" },
+    { NULL, NULL }
+};
+
+static const struct fru_field_def bia_fields[] =
+{
+    { "manufacturer",   "manufacturer_size" },
+    { "product_name",   "product_name_size" },
+    { "serial_number",  "serial_number_size" },
+    { "part_number",    "part_number_size" },
+    { "fru_file_id",    "fru_file_id_size" },
+    { "version",        "version_size" },
+    { "asset_tag",      "asset_tag_size" },
+    { NULL, NULL }
+};
+
+static const struct fru_field_def pia_fields[] =
+{
+    { "manufacturer",   "manufacturer_size" },
+    { "product_name",   "product_name_size" },
+    { "part_number",    "part_number_size" },
+    { "version",        "version_size" },
+    { "serial_number",  "serial_number_size" },
+    { "asset_tag",      "asset_tag_size" },
+    { "fru_file_id",    "fru_file_id_size" },
+    { "product_family", "family_size" },
+    { "sku_id",         "sku_id_size" },
+    { NULL, NULL }
+};
+
+/* Fixed-position fields preceding the type/length chain */
+static const char *cia_fixed[] = { "chassis_type", NULL };
+static const char *bia_fixed[] = { "language_code", "mfg_datetime", NULL };
+static const char *pia_fixed[] = { "language_code", NULL };
+
+const struct fru_field_def *fru_area_fields( int area )
+{
+    switch( area )
+    {
+        case FRU_AREA_CIA:
+            return cia_fields;
+        case FRU_AREA_BIA:
+            return bia_fields;
+        case FRU_AREA_PIA:
+            return pia_fields;
+        default:
+            return NULL;
+    }
+}
+
+static const char **area_fixed_fields( int area )
+{
+    switch( area )
+    {
+        case FRU_AREA_CIA:
+            return cia_fixed;
+        case FRU_AREA_BIA:
+            return bia_fixed;
+        case FRU_AREA_PIA:
+            return pia_fixed;
+        default:
+            return NULL;
+    }
+}
+
+/*
+ * True for keys the generator consumes itself (fixed fields, predefined
+ * fields and their *_size companions); every other key of an info area
+ * section becomes a custom field.
+ */
+int fru_is_predefined_key( int area, const char *key )
+{
+    const struct fru_field_def *defs = fru_area_fields( area );
+    const char **fixed = area_fixed_fields( area );
+
+    if( !defs )
+        return 0;
+    for( ; *fixed; fixed++ )
+    {
+        if( !strcmp( key, *fixed ) )
+            return 1;
+    }
+    for( ; defs->name; defs++ )
+    {
+        if( !strcmp( key, defs->name ) || !strcmp( key, defs->size_key ) )
+            return 1;
+    }
+    return 0;
+}
+
+const char *fru_field_size_key( int area, const char *name )
+{
+    const struct fru_field_def *defs = fru_area_fields( area );
+
+    for( ; defs && defs->name; defs++ )
+    {
+        if( !strcmp( name, defs->name ) )
+            return defs->size_key;
+    }
+    return NULL;
+}
+
+const char *fru_area_name( int area )
+{
+    if( area < 0 || area >= FRU_AREA_NUM )
+        return NULL;
+    return area_names[area];
+}
+
+int fru_area_by_name( const char *name )
+{
+    int i;
+
+    for( i = 0; i < FRU_AREA_NUM; i++ )
+    {
+        if( !strcmp( name, area_names[i] ) )
+            return i;
+    }
+    return -1;
+}
+
+static void add_fixed_field( struct fru_area *area, const char *name,
+                             const uint8_t *image, int offset, int length )
+{
+    struct fru_field *f = &area->fields[area->num_fields++];
+
+    f->name = name;
+    f->custom = -1;
+    f->offset = offset;
+    f->fixed = 1;
+    f->type = TYPE_CODE_BINARY;
+    f->length = length;
+    f->data = image + offset;
+}
+
+/* Walk the type/length chain of one info area */
+static int read_info_area( struct fru_image *img, int id, int offset )
+{
+    struct fru_area *area = &img->areas[id];
+    const uint8_t *image = img->data;
+    const struct fru_field_def *names;
+    int pos, end, num_custom, i;
+    uint8_t tl;
+
+    if( offset + 8 > img->length )
+        return -1;
+
+    area->present = 1;
+    area->offset = offset;
+    area->length = image[offset + 1] * 8;
+    if( !area->length || offset + area->length > img->length )
+        return -1;
+    end = offset + area->length;
+    area->cksum_offset = end - 1;
+    area->cksum_ok = !get_zero_cksum( image + offset, area->length );
+
+    switch( id )
+    {
+        case FRU_AREA_CIA:
+            names = cia_fields;
+            add_fixed_field( area, "chassis_type", image, offset + 2, 1 );
+            pos = offset + 3;
+            break;
+        case FRU_AREA_BIA:
+            names = bia_fields;
+            add_fixed_field( area, "language_code", image, offset + 2, 1 );
+            add_fixed_field( area, "mfg_datetime", image, offset + 3, 3 );
+            pos = offset + 6;
+            break;
+        default:
+            names = pia_fields;
+            add_fixed_field( area, "language_code", image, offset + 2, 1 );
+            pos = offset + 3;
+            break;
+    }
+
+    i = num_custom = 0;
+    while( pos < end - 1 )
+    {
+        struct fru_field *f;
+
+        tl = image[pos];
+        if( tl == FRU_END_MARKER )
+        {
+            area->end_offset = pos;
+            return 0;
+        }
+        if( area->num_fields == FRU_MAX_FIELDS ||
+            pos + 1 + ( tl & 0x3f ) > end - 1 )
+            return -1;
+
+        f = &area->fields[area->num_fields++];
+        f->offset = pos;
+        f->fixed = 0;
+        f->type = tl & 0xc0;
+        f->length = tl & 0x3f;
+        f->data = image + pos + 1;
+        if( names[i].name )
+        {
+            f->name = names[i++].name;
+            f->custom = -1;
+        }
+        else
+        {
+            f->name = NULL;
+            f->custom = num_custom++;
+        }
+
+        pos += 1 + f->length;
+    }
+
+    /* No end marker inside the area */
+    return -1;
+}
+
+static void read_multirecords( struct fru_image *img, int offset )
+{
+    const uint8_t *image = img->data;
+    struct fru_record *rec;
+    const uint8_t *h;
+
+    img->mia_offset = offset;
+    while( img->num_records < FRU_MAX_RECORDS &&
+           offset + ( int ) sizeof( struct multi_record_header ) <= img->length )
+    {
+        h = image + offset;
+        /* An all-zero header is blank storage, not a record */
+        if( !( h[0] | h[1] | h[2] | h[3] | h[4] ) ||
+            get_zero_cksum( h, sizeof( struct multi_record_header ) ) )
+            break;
+        if( offset + ( int ) sizeof( struct multi_record_header ) + h[2] > img->length )
+            break;
+
+        rec = &img->records[img->num_records++];
+        rec->offset = offset;
+        rec->type_id = h[0];
+        rec->format_version = h[1];
+        rec->length = h[2];
+        rec->data = h + sizeof( struct multi_record_header );
+        rec->cksum_ok = get_zero_cksum( rec->data, rec->length ) == h[3];
+
+        offset += sizeof( struct multi_record_header ) + rec->length;
+        if( offset > img->used_length )
+            img->used_length = offset;
+
+        if( h[1] & MULTI_RECORD_EOL )
+            break;
+    }
+}
+
+/*
+ * Parse a FRU image. Returns 0 when the common header and every area it
+ * points to could be walked, -1 otherwise; whatever was recognised before
+ * the failure is left in img.
+ */
+int fru_read_image( const uint8_t *data, int length, struct fru_image *img )
+{
+    const struct fru_common_header *fch;
+    int offsets[FRU_AREA_NUM], next, i, j, ret;
+
+    memset( img, 0, sizeof( *img ) );
+    img->data = data;
+    img->length = length;
+
+    if( length < ( int ) sizeof( struct fru_common_header ) )
+        return -1;
+
+    fch = ( const struct fru_common_header * ) data;
+    img->header_ok = fch->format_version == 0x01 &&
+                     !get_zero_cksum( data, sizeof( struct fru_common_header ) );
+    if( !img->header_ok )
+        return -1;
+    img->used_length = sizeof( struct fru_common_header );
+
+    offsets[FRU_AREA_IUA] = fch->internal_use_offset * 8;
+    offsets[FRU_AREA_CIA] = fch->chassis_info_offset * 8;
+    offsets[FRU_AREA_BIA] = fch->board_info_offset * 8;
+    offsets[FRU_AREA_PIA] = fch->product_info_offset * 8;
+
+    ret = 0;
+    for( i = FRU_AREA_CIA; i < FRU_AREA_NUM; i++ )
+    {
+        if( !offsets[i] )
+            continue;
+        if( read_info_area( img, i, offsets[i] ) )
+            ret = -1;
+        else if( offsets[i] + img->areas[i].length > img->used_length )
+            img->used_length = offsets[i] + img->areas[i].length;
+    }
+
+    /* The IUA has no length of its own: it runs up to whatever follows it */
+    if( offsets[FRU_AREA_IUA] )
+    {
+        next = length;
+        for( j = FRU_AREA_CIA; j < FRU_AREA_NUM; j++ )
+        {
+            if( offsets[j] > offsets[FRU_AREA_IUA] && offsets[j] < next )
+                next = offsets[j];
+        }
+        if( fch->multirecord_info_offset * 8 > offsets[FRU_AREA_IUA] &&
+            fch->multirecord_info_offset * 8 < next )
+            next = fch->multirecord_info_offset * 8;
+
+        if( offsets[FRU_AREA_IUA] < length )
+        {
+            img->areas[FRU_AREA_IUA].present = 1;
+            img->areas[FRU_AREA_IUA].offset = offsets[FRU_AREA_IUA];
+            img->areas[FRU_AREA_IUA].length = next - offsets[FRU_AREA_IUA];
+            img->areas[FRU_AREA_IUA].cksum_offset = -1;
+            img->areas[FRU_AREA_IUA].cksum_ok = 1;
+            if( next > img->used_length )
+                img->used_length = next;
+        }
+        else
+            ret = -1;
+    }
+
+    if( fch->multirecord_info_offset )
+        read_multirecords( img, fch->multirecord_info_offset * 8 );
+
+    return ret;
+}
+
+/*
+ * Look a field up by its predefined key name, or "custom_N" (1-based) for
+ * the custom fields that follow the predefined ones.
+ */
+struct fru_field *fru_find_field( struct fru_image *img, int area, const char *name )
+{
+    struct fru_area *a;
+    int i, custom;
+
+    if( area < 0 || area >= FRU_AREA_NUM || !img->areas[area].present )
+        return NULL;
+    a = &img->areas[area];
+
+    custom = -1;
+    if( !strncmp( name, "custom_", 7 ) )
+        custom = atoi( name + 7 ) - 1;
+
+    for( i = 0; i < a->num_fields; i++ )
+    {
+        if( a->fields[i].name && !strcmp( a->fields[i].name, name ) )
+            return &a->fields[i];
+        if( custom >= 0 && a->fields[i].custom == custom )
+            return &a->fields[i];
+    }
+    return NULL;
+}
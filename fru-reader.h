@@ -0,0 +1,90 @@
+#ifndef FRU_READER_H
+#define FRU_READER_H
+
+#include <inttypes.h>
+
+#include "fru-defs.h"
+
+/*
+ * Zero-copy FRU image reader
+ *
+ * fru_read_image() walks the common header, the type/length chain of every
+ * info area and the MultiRecord list, and records where everything lives.
+ * Nothing is allocated or copied: fields point straight into the image.
+ */
+
+enum fru_area_id
+{
+    FRU_AREA_IUA = 0,
+    FRU_AREA_CIA,
+    FRU_AREA_BIA,
+    FRU_AREA_PIA,
+    FRU_AREA_NUM,
+};
+
+#define FRU_MAX_FIELDS      64
+#define FRU_MAX_RECORDS     64
+
+#define FRU_END_MARKER      0xc1
+#define MULTI_RECORD_EOL    0x80
+
+struct fru_field_def
+{
+    const char      *name;
+    const char      *size_key;  /* config key giving the reserved capacity */
+};
+
+struct fru_field
+{
+    const char      *name;      /* predefined key name, NULL for custom fields */
+    int             custom;     /* index among custom fields, -1 if predefined */
+    int             offset;     /* absolute offset of the type/length byte */
+    int             fixed;      /* no type/length byte (e.g. BIA mfg_datetime) */
+    uint8_t         type;       /* TYPE_CODE_* */
+    int             length;     /* data bytes */
+    const uint8_t   *data;
+};
+
+struct fru_area
+{
+    int             present;
+    int             offset;     /* absolute offset of the area */
+    int             length;     /* bytes, including the checksum */
+    int             end_offset; /* absolute offset of the 0xC1 end marker */
+    int             cksum_offset;
+    int             cksum_ok;
+    int             num_fields;
+    struct fru_field fields[FRU_MAX_FIELDS];
+};
+
+struct fru_record
+{
+    int             offset;     /* absolute offset of the record header */
+    uint8_t         type_id;
+    uint8_t         format_version;
+    int             length;     /* record data bytes */
+    const uint8_t   *data;
+    int             cksum_ok;
+};
+
+struct fru_image
+{
+    const uint8_t   *data;
+    int             length;
+    int             used_length;    /* end of the last area/record */
+    int             header_ok;
+    struct fru_area areas[FRU_AREA_NUM];
+    int             mia_offset;
+    int             num_records;
+    struct fru_record records[FRU_MAX_RECORDS];
+};
+
+const char *fru_area_name( int area );
+int fru_area_by_name( const char *name );
+const struct fru_field_def *fru_area_fields( int area );
+int fru_is_predefined_key( int area, const char *key );
+const char *fru_field_size_key( int area, const char *name );
+int fru_read_image( const uint8_t *data, int length, struct fru_image *img );
+struct fru_field *fru_find_field( struct fru_image *img, int area, const char *name );
+
+#endif
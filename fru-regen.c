@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fru-regen.h"
+
+struct fru_regen *regen_cache = NULL;
+
+#define FNV_OFFSET  0xcbf29ce484222325ULL
+#define FNV_PRIME   0x100000001b3ULL
+
+/* FNV-1a, the terminating nul is hashed too so "ab","c" differs from "a","bc" */
+uint64_t fru_regen_hash( uint64_t hash, const char *str )
+{
+    if( !hash )
+        hash = FNV_OFFSET;
+    if( !str )
+        return hash * FNV_PRIME;
+    do
+    {
+        hash ^= ( uint8_t ) *str;
+        hash *= FNV_PRIME;
+    }
+    while( *str++ );
+
+    return hash;
+}
+
+/* Every key and value of a section, in config order */
+uint64_t fru_regen_hash_section( dictionary *ini, const char *section, uint64_t hash )
+{
+    int length, i;
+
+    length = strlen( section );
+    hash = fru_regen_hash( hash, section );
+    for( i = 0; i < ini->size; i++ )
+    {
+        if( !ini->key[i] || strncmp( ini->key[i], section, length ) ||
+            ini->key[i][length] != ':' )
+            continue;
+        hash = fru_regen_hash( hash, ini->key[i] + length + 1 );
+        hash = fru_regen_hash( hash, ini->val[i] );
+    }
+
+    return hash;
+}
+
+static struct fru_regen_entry *find_entry( struct fru_regen *rc, const char *section )
+{
+    int i;
+
+    for( i = 0; i < rc->num; i++ )
+    {
+        if( !strcmp( rc->entries[i].section, section ) )
+            return &rc->entries[i];
+    }
+    return NULL;
+}
+
+struct fru_regen_entry *fru_regen_lookup( struct fru_regen *rc, const char *section,
+                                          uint64_t hash )
+{
+    struct fru_regen_entry *e = find_entry( rc, section );
+
+    if( !e || !e->valid || e->hash != hash )
+        return NULL;
+    rc->reused++;
+    return e;
+}
+
+/*
+ * The cache takes ownership of data, except when it is full: NULL is
+ * returned and data stays the caller's. valid is 0 for inputs that must not
+ * be reused.
+ */
+struct fru_regen_entry *fru_regen_store( struct fru_regen *rc, const char *section,
+                                         uint64_t hash, int valid, char *data, int length )
+{
+    struct fru_regen_entry *e = find_entry( rc, section );
+
+    rc->encoded++;
+    if( !e )
+    {
+        if( rc->num == FRU_REGEN_MAX_ENTRIES )
+            return NULL;
+        e = &rc->entries[rc->num++];
+        e->section = strdup( section );
+    }
+    else if( e->data != data )
+        free( e->data );
+
+    e->hash = hash;
+    e->valid = valid;
+    e->data = data;
+    e->length = length;
+
+    return e;
+}
+
+/* True when every area has the length, presence and class it had in the previous image */
+int fru_regen_same_shape( const struct fru_regen *rc, const struct fru_area_blob *areas,
+                          int num )
+{
+    int i;
+
+    if( !rc->image )
+        return 0;
+    for( i = 0; i < num; i++ )
+    {
+        if( ( areas[i].data ? areas[i].length : 0 ) != rc->lengths[i] ||
+            areas[i].hot != rc->hot[i] )
+            return 0;
+    }
+    return 1;
+}
+
+void fru_regen_save_image( struct fru_regen *rc, const struct fru_area_blob *areas, int num,
+                           const char *image, int length )
+{
+    int i;
+
+    rc->image = ( char * ) realloc( rc->image, length );
+    memcpy( rc->image, image, length );
+    rc->image_length = length;
+    for( i = 0; i < num; i++ )
+    {
+        rc->offsets[i] = areas[i].data ? areas[i].offset : 0;
+        rc->lengths[i] = areas[i].data ? areas[i].length : 0;
+        rc->hot[i] = areas[i].hot;
+    }
+}
+
+void fru_regen_free( struct fru_regen *rc )
+{
+    int i;
+
+    for( i = 0; i < rc->num; i++ )
+    {
+        free( ( char * ) rc->entries[i].section );
+        free( rc->entries[i].data );
+    }
+    free( rc->image );
+    free( rc );
+}
@@ -0,0 +1,67 @@
+#ifndef FRU_REGEN_H
+#define FRU_REGEN_H
+
+#include <inttypes.h>
+
+#include "iniparser.h"
+#include "fru-layout.h"
+
+/*
+ * Incremental regeneration
+ *
+ * Every info area and MultiRecord record is keyed by a hash of the config
+ * keys its gen_* function reads. Between two gen_fru_data() calls an input
+ * whose hash is unchanged reuses the previous encoded blob. If no area
+ * changed length, the previous image is reused as is: only the re-encoded
+ * areas are copied into it, and the common header stays untouched.
+ *
+ * Inputs that differ on every run are never cached: a BIA without
+ * mfg_datetime (stamped with the current time), random UUIDs and MAC pool
+ * allocations.
+ */
+
+#define FRU_REGEN_MAX_ENTRIES   32
+#define FRU_REGEN_MAX_AREAS     5
+
+struct fru_regen_entry
+{
+    const char  *section;
+    uint64_t    hash;
+    int         valid;
+    char        *data;
+    int         length;
+};
+
+struct fru_regen
+{
+    int                     num;
+    struct fru_regen_entry  entries[FRU_REGEN_MAX_ENTRIES];
+
+    /* Previous image and where its areas went */
+    char                    *image;
+    int                     image_length;
+    int                     offsets[FRU_REGEN_MAX_AREAS];
+    int                     lengths[FRU_REGEN_MAX_AREAS];
+    int                     hot[FRU_REGEN_MAX_AREAS];
+
+    /* What the last pass did */
+    int                     encoded;    /* areas and records re-encoded */
+    int                     reused;     /* taken from the cache */
+    int                     relaid;     /* area lengths changed, layout redone */
+};
+
+extern struct fru_regen *regen_cache;
+
+uint64_t fru_regen_hash( uint64_t hash, const char *str );
+uint64_t fru_regen_hash_section( dictionary *ini, const char *section, uint64_t hash );
+struct fru_regen_entry *fru_regen_lookup( struct fru_regen *rc, const char *section,
+                                          uint64_t hash );
+struct fru_regen_entry *fru_regen_store( struct fru_regen *rc, const char *section,
+                                         uint64_t hash, int valid, char *data, int length );
+int fru_regen_same_shape( const struct fru_regen *rc, const struct fru_area_blob *areas,
+                          int num );
+void fru_regen_save_image( struct fru_regen *rc, const struct fru_area_blob *areas, int num,
+                           const char *image, int length );
+void fru_regen_free( struct fru_regen *rc );
+
+#endif
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "fru-scan.h"
+#include "fru-reader.h"
+
+/* Byte 0 of a header is its format version, byte 6 the pad, in a little-endian word */
+#define HEADER_KEY_MASK     0x00ff0000000000ffULL
+#define HEADER_KEY          0x0000000000000001ULL
+
+/* One candidate per 64-bit word: version 1, zero pad, bytes summing to 0 mod 256 */
+static int is_header_word( uint64_t word )
+{
+    uint64_t sum;
+
+    if( ( word & HEADER_KEY_MASK ) != HEADER_KEY )
+        return 0;
+    sum = ( word & 0x00ff00ff00ff00ffULL ) + ( ( word >> 8 ) & 0x00ff00ff00ff00ffULL );
+    sum += sum >> 16;
+    sum += sum >> 32;
+    return !( sum & 0xff );
+}
+
+static int check_word( const uint8_t *data )
+{
+    uint64_t word;
+
+    memcpy( &word, data, sizeof( word ) );
+    return is_header_word( word );
+}
+
+#ifdef __SSE2__
+
+/*
+ * Version and pad bytes of the two 8-byte halves of v, compared at once:
+ * a half matches when both of its dwords compare equal, i.e. movemask bits
+ * 0-7 (first half) or 8-15 (second half) are all set.
+ */
+static inline __m128i version_match( __m128i v )
+{
+    return _mm_cmpeq_epi32( _mm_and_si128( v, _mm_set1_epi64x( HEADER_KEY_MASK ) ),
+                            _mm_set1_epi64x( HEADER_KEY ) );
+}
+
+/* Same, also requiring each half to sum to 0 mod 256 (psadbw byte sums) */
+static inline int header_mask( __m128i v )
+{
+    __m128i sum;
+
+    sum = _mm_and_si128( _mm_sad_epu8( v, _mm_setzero_si128() ), _mm_set1_epi64x( 0xff ) );
+    return _mm_movemask_epi8( _mm_and_si128( version_match( v ),
+                                             _mm_cmpeq_epi32( sum, _mm_setzero_si128() ) ) );
+}
+
+/* Offset of the next candidate at or after pos, or end */
+static size_t next_candidate( const uint8_t *data, size_t pos, size_t end )
+{
+    __m128i v[4], any;
+    int i, mask;
+
+    /* 64 bytes, eight candidates, per round */
+    while( pos + 64 <= end )
+    {
+        for( i = 0; i < 4; i++ )
+            v[i] = _mm_loadu_si128( ( const __m128i * ) ( data + pos + 16 * i ) );
+
+        /*
+         * Merging the four version matches can only add false hits (a
+         * version byte from one vector, a pad byte from another), and the
+         * checksum is only summed once something looks like a header.
+         */
+        any = _mm_or_si128( _mm_or_si128( version_match( v[0] ), version_match( v[1] ) ),
+                            _mm_or_si128( version_match( v[2] ), version_match( v[3] ) ) );
+        mask = _mm_movemask_epi8( any );
+        if( ( mask & 0x00ff ) == 0x00ff || ( mask & 0xff00 ) == 0xff00 )
+        {
+            for( i = 0; i < 4; i++ )
+            {
+                mask = header_mask( v[i] );
+                if( ( mask & 0x00ff ) == 0x00ff )
+                    return pos + 16 * i;
+                if( ( mask & 0xff00 ) == 0xff00 )
+                    return pos + 16 * i + 8;
+            }
+        }
+        pos += 64;
+    }
+
+    for( ; pos + 8 <= end; pos += 8 )
+    {
+        if( check_word( data + pos ) )
+            return pos;
+    }
+    return end;
+}
+
+#else
+
+static size_t next_candidate( const uint8_t *data, size_t pos, size_t end )
+{
+    for( ; pos + 8 <= end; pos += 8 )
+    {
+        if( check_word( data + pos ) )
+            return pos;
+    }
+    return end;
+}
+
+#endif
+
+/*
+ * A candidate header is an image if every area and record it points to
+ * parses with good checksums. Returns the image length, 0 if it is not one.
+ */
+static int validate( const uint8_t *data, int length, int *open_iua )
+{
+    struct fru_image img;
+    int i, areas;
+
+    *open_iua = 0;
+    if( fru_read_image( data, length, &img ) || !img.header_ok )
+        return 0;
+
+    areas = 0;
+    for( i = FRU_AREA_CIA; i < FRU_AREA_NUM; i++ )
+    {
+        if( !img.areas[i].present )
+            continue;
+        if( data[img.areas[i].offset] != 0x01 || !img.areas[i].cksum_ok )
+            return 0;
+        areas++;
+    }
+    if( img.mia_offset )
+    {
+        if( !img.num_records || !( img.records[img.num_records - 1].format_version & MULTI_RECORD_EOL ) )
+            return 0;
+        for( i = 0; i < img.num_records; i++ )
+        {
+            if( !img.records[i].cksum_ok )
+                return 0;
+        }
+    }
+    /* A lone IUA pointer is too weak a signal in random data */
+    if( !areas && !img.num_records )
+        return 0;
+
+    /* The IUA runs up to whatever follows it, the end of the window if nothing does */
+    if( img.areas[FRU_AREA_IUA].present &&
+        img.areas[FRU_AREA_IUA].offset + img.areas[FRU_AREA_IUA].length == length )
+        *open_iua = 1;
+
+    return img.used_length;
+}
+
+static int write_image( const char *dir, unsigned long long offset, const uint8_t *data,
+                        int length )
+{
+    char path[PATH_MAX];
+    int fd, ret;
+
+    snprintf( path, sizeof( path ), "%s/%08llx.bin", dir, offset );
+    if( ( fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) == -1 )
+    {
+        perror( "Carved image open:" );
+        return -1;
+    }
+    ret = write( fd, data, length ) == length ? 0 : -1;
+    if( ret )
+        perror( "Carved image write:" );
+    close( fd );
+
+    return ret;
+}
+
+/* Returns the number of images found, -1 on error */
+int fru_scan_file( const char *path, const char *dir )
+{
+    const uint8_t *data;
+    struct stat st;
+    size_t size, pos, window;
+    int fd, found, length, open_iua;
+
+    if( ( fd = open( path, O_RDONLY ) ) == -1 || fstat( fd, &st ) )
+    {
+        perror( "Scan open:" );
+        if( fd != -1 )
+            close( fd );
+        return -1;
+    }
+    size = st.st_size;
+    if( !size )
+    {
+        close( fd );
+        return 0;
+    }
+    data = ( const uint8_t * ) mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( data == MAP_FAILED )
+    {
+        perror( "Scan mmap:" );
+        return -1;
+    }
+    madvise( ( void * ) data, size, MADV_SEQUENTIAL );
+
+    found = 0;
+    for( pos = next_candidate( data, 0, size ); pos < size; pos = next_candidate( data, pos, size ) )
+    {
+        window = size - pos < FRU_SCAN_WINDOW ? size - pos : FRU_SCAN_WINDOW;
+        if( ( length = validate( data + pos, window, &open_iua ) ) == 0 )
+        {
+            pos += 8;
+            continue;
+        }
+
+        found++;
+        fprintf( stdout, "0x%08llx: FRU image, %d bytes%s\n", ( unsigned long long ) pos, length,
+                 open_iua ? " (the IUA has no end, cut at the scan window)" : "" );
+        if( dir && write_image( dir, pos, data + pos, length ) )
+        {
+            found = -1;
+            break;
+        }
+        /* An image does not contain another one */
+        pos += ( length + 7 ) & ~7;
+    }
+
+    munmap( ( void * ) data, size );
+
+    return found;
+}
@@ -0,0 +1,23 @@
+#ifndef FRU_SCAN_H
+#define FRU_SCAN_H
+
+/*
+ * FRU image carving (--scan)
+ *
+ * A raw flash or EEPROM dump is mapped and every 8-byte aligned offset is
+ * tested for a common header: format version 1, a zero pad byte and a zero
+ * checksum. With SSE2 eight offsets are tested per 64 bytes and only a
+ * version/pad match is summed (_mm_sad_epu8()), otherwise one offset per
+ * 64-bit word. The rare
+ * candidates are then parsed with fru_read_image() and kept only if every
+ * area and record they point to is well formed.
+ *
+ * Every image found is printed with its offset and, when dir is set,
+ * written to dir as <offset>.bin.
+ */
+
+#define FRU_SCAN_WINDOW     65536   /* bytes given to the parser per candidate */
+
+int fru_scan_file( const char *path, const char *dir );
+
+#endif
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "fru-stats.h"
+#include "fru-timeline.h"
+
+#ifdef FRU_STATS
+
+#define STATS_MAX_STAGES    48
+#define STATS_HIST_BUCKETS  40
+
+/* Bucket k counts values in [2^(k-1), 2^k), bucket 0 counts zeros */
+struct histogram
+{
+    uint64_t    buckets[STATS_HIST_BUCKETS];
+};
+
+struct stage
+{
+    const char          *name;
+    uint64_t            count;
+    uint64_t            total_ns;
+    struct histogram    hist_us;
+};
+
+/* Counters of the unit the current thread is generating */
+struct unit_counters
+{
+    int         active;
+    uint64_t    values[FRU_STAT_NUM];
+};
+
+int fru_stats_enabled = 0;
+
+static const char *stats_path;
+static uint64_t totals[FRU_STAT_NUM];
+static uint64_t num_units;
+static struct histogram unit_time_us;
+static struct histogram unit_image_bytes;
+static struct histogram unit_hists[FRU_STAT_NUM];
+
+static struct stage stages[STATS_MAX_STAGES];
+static int num_stages;
+static pthread_mutex_t stages_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread struct unit_counters unit;
+
+static const char *counter_names[FRU_STAT_NUM] =
+{
+    "dictionary_lookups",
+    "allocations",
+    "allocated_bytes",
+    "bytes_written",
+    "files_written",
+};
+
+uint64_t fru_stats_now( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void hist_add( struct histogram *h, uint64_t value )
+{
+    int bucket = value ? 64 - __builtin_clzll( value ) : 0;
+
+    if( bucket >= STATS_HIST_BUCKETS )
+        bucket = STATS_HIST_BUCKETS - 1;
+    __atomic_fetch_add( &h->buckets[bucket], 1, __ATOMIC_RELAXED );
+}
+
+static struct stage *find_stage( const char *name )
+{
+    int i, num;
+
+    num = __atomic_load_n( &num_stages, __ATOMIC_ACQUIRE );
+    for( i = 0; i < num; i++ )
+    {
+        if( stages[i].name == name || !strcmp( stages[i].name, name ) )
+            return &stages[i];
+    }
+
+    pthread_mutex_lock( &stages_lock );
+    for( i = 0; i < num_stages; i++ )
+    {
+        if( !strcmp( stages[i].name, name ) )
+            break;
+    }
+    if( i == num_stages && num_stages < STATS_MAX_STAGES )
+    {
+        stages[i].name = name;
+        __atomic_store_n( &num_stages, num_stages + 1, __ATOMIC_RELEASE );
+    }
+    pthread_mutex_unlock( &stages_lock );
+
+    return i < STATS_MAX_STAGES ? &stages[i] : NULL;
+}
+
+void fru_stats_stage( const char *name, uint64_t start )
+{
+    uint64_t end = fru_stats_now(), elapsed = end - start;
+    struct stage *s;
+
+    if( fru_stats_enabled & FRU_STATS_TIMELINE )
+        fru_timeline_span( name, start, end );
+    if( !( fru_stats_enabled & FRU_STATS_REPORT ) || ( s = find_stage( name ) ) == NULL )
+        return;
+    __atomic_fetch_add( &s->count, 1, __ATOMIC_RELAXED );
+    __atomic_fetch_add( &s->total_ns, elapsed, __ATOMIC_RELAXED );
+    hist_add( &s->hist_us, elapsed / 1000 );
+}
+
+void fru_stats_count( int counter, uint64_t n )
+{
+    __atomic_fetch_add( &totals[counter], n, __ATOMIC_RELAXED );
+    if( unit.active )
+        unit.values[counter] += n;
+}
+
+void fru_stats_unit_begin( void )
+{
+    memset( &unit, 0, sizeof( unit ) );
+    unit.active = 1;
+}
+
+void fru_stats_unit_end( uint64_t start, int image_length )
+{
+    uint64_t end = fru_stats_now();
+    int i;
+
+    unit.active = 0;
+    if( fru_stats_enabled & FRU_STATS_TIMELINE )
+        fru_timeline_span( "unit", start, end );
+    if( !( fru_stats_enabled & FRU_STATS_REPORT ) )
+        return;
+    __atomic_fetch_add( &num_units, 1, __ATOMIC_RELAXED );
+    hist_add( &unit_time_us, ( end - start ) / 1000 );
+    hist_add( &unit_image_bytes, image_length );
+    for( i = 0; i < FRU_STAT_NUM; i++ )
+        hist_add( &unit_hists[i], unit.values[i] );
+}
+
+/* Non-empty buckets as [upper bound, count] pairs */
+static void print_hist( FILE *out, const struct histogram *h )
+{
+    int i, first;
+
+    fprintf( out, "[" );
+    for( first = 1, i = 0; i < STATS_HIST_BUCKETS; i++ )
+    {
+        if( !h->buckets[i] )
+            continue;
+        fprintf( out, "%s[%llu, %llu]", first ? "" : ", ",
+                 i ? ( 1ULL << i ) - 1 : 0ULL, ( unsigned long long ) h->buckets[i] );
+        first = 0;
+    }
+    fprintf( out, "]" );
+}
+
+static void report( void )
+{
+    FILE *out = stderr;
+    int i;
+
+    fru_stats_enabled &= ~FRU_STATS_REPORT;
+    if( stats_path && ( out = fopen( stats_path, "w" ) ) == NULL )
+    {
+        perror( "Stats open:" );
+        return;
+    }
+
+    fprintf( out, "{\n  \"units\": %llu,\n  \"counters\": {", ( unsigned long long ) num_units );
+    for( i = 0; i < FRU_STAT_NUM; i++ )
+        fprintf( out, "%s\n    \"%s\": %llu", i ? "," : "", counter_names[i],
+                 ( unsigned long long ) totals[i] );
+
+    fprintf( out, "\n  },\n  \"stages\": [" );
+    for( i = 0; i < num_stages; i++ )
+    {
+        fprintf( out, "%s\n    { \"name\": \"%s\", \"count\": %llu, \"total_ns\": %llu, "
+                 "\"hist_us\": ", i ? "," : "", stages[i].name,
+                 ( unsigned long long ) stages[i].count, ( unsigned long long ) stages[i].total_ns );
+        print_hist( out, &stages[i].hist_us );
+        fprintf( out, " }" );
+    }
+
+    fprintf( out, "\n  ],\n  \"per_unit\": {\n    \"time_us\": " );
+    print_hist( out, &unit_time_us );
+    fprintf( out, ",\n    \"image_bytes\": " );
+    print_hist( out, &unit_image_bytes );
+    /* Images are written after the unit ends */
+    for( i = 0; i < FRU_STAT_NUM; i++ )
+    {
+        if( i == FRU_STAT_BYTES_WRITTEN || i == FRU_STAT_FILES_WRITTEN )
+            continue;
+        fprintf( out, ",\n    \"%s\": ", counter_names[i] );
+        print_hist( out, &unit_hists[i] );
+    }
+    fprintf( out, "\n  }\n}\n" );
+
+    if( out != stderr )
+        fclose( out );
+}
+
+/* Report to path, or stderr if NULL, when the process exits */
+int fru_stats_enable( const char *path )
+{
+    stats_path = path;
+    fru_stats_enabled |= FRU_STATS_REPORT;
+    return atexit( report );
+}
+
+#else
+
+int fru_stats_enable( const char *path )
+{
+    fprintf( stderr, "\nError! --stats needs a build with STATS=1\n\n" );
+    return -1;
+}
+
+#endif
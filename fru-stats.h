@@ -0,0 +1,68 @@
+#ifndef FRU_STATS_H
+#define FRU_STATS_H
+
+#include <stdio.h>
+#include <inttypes.h>
+
+/*
+ * Run statistics (--stats)
+ *
+ * Stage timings (config load, every area and record encoder, image
+ * assembly, output writes) and counters (dictionary lookups, allocations,
+ * bytes written) are collected while the tool runs and printed as JSON on
+ * exit, together with per-unit histograms: a unit is one gen_fru_data()
+ * call, i.e. one image.
+ *
+ * The probes are compiled in with -DFRU_STATS (make STATS=1, the default)
+ * and cost one predictable branch each until --stats is given; with
+ * make STATS=0 they are compiled out altogether. Allocations are counted
+ * by the link-time allocator wrappers in fru-alloc.c, so iniparser's
+ * allocations are included.
+ *
+ * The same probes feed the --trace timeline, see fru-timeline.h.
+ */
+
+enum fru_stats_counter
+{
+    FRU_STAT_LOOKUPS = 0,
+    FRU_STAT_ALLOCS,
+    FRU_STAT_ALLOC_BYTES,
+    FRU_STAT_BYTES_WRITTEN,
+    FRU_STAT_FILES_WRITTEN,
+    FRU_STAT_NUM,
+};
+
+/* fru_stats_enabled bits */
+#define FRU_STATS_REPORT        0x1
+#define FRU_STATS_TIMELINE      0x2
+
+#ifdef FRU_STATS
+
+extern int fru_stats_enabled;
+
+uint64_t fru_stats_now( void );
+void fru_stats_stage( const char *name, uint64_t start );
+void fru_stats_count( int counter, uint64_t n );
+void fru_stats_unit_begin( void );
+void fru_stats_unit_end( uint64_t start, int image_length );
+
+/* Stage names must stay valid until exit: pass string constants */
+#define FRU_STATS_START( t )            uint64_t t = fru_stats_enabled ? fru_stats_now() : 0
+#define FRU_STATS_STAGE( name, t )      do { if( fru_stats_enabled ) fru_stats_stage( name, t ); } while( 0 )
+#define FRU_STATS_COUNT( counter, n )   do { if( fru_stats_enabled ) fru_stats_count( counter, n ); } while( 0 )
+#define FRU_STATS_UNIT_BEGIN()          do { if( fru_stats_enabled ) fru_stats_unit_begin(); } while( 0 )
+#define FRU_STATS_UNIT_END( t, n )      do { if( fru_stats_enabled ) fru_stats_unit_end( t, n ); } while( 0 )
+
+#else
+
+#define FRU_STATS_START( t )            do { } while( 0 )
+#define FRU_STATS_STAGE( name, t )      do { } while( 0 )
+#define FRU_STATS_COUNT( counter, n )   do { } while( 0 )
+#define FRU_STATS_UNIT_BEGIN()          do { } while( 0 )
+#define FRU_STATS_UNIT_END( t, n )      do { } while( 0 )
+
+#endif
+
+int fru_stats_enable( const char *path );
+
+#endif
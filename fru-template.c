@@ -0,0 +1,481 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "fru-template.h"
+#include "fru-uuid.h"
+
+int fru_vars_set( struct fru_vars *vars, const char *name, const char *value )
+{
+    int i;
+
+    for( i = 0; i < vars->num; i++ )
+    {
+        if( !strcmp( vars->names[i], name ) )
+        {
+            vars->values[i] = value;
+            return 0;
+        }
+    }
+    if( vars->num == FRU_MAX_VARS )
+        return -1;
+
+    vars->names[vars->num] = name;
+    vars->values[vars->num] = value;
+    vars->num++;
+
+    return 0;
+}
+
+/* "NAME=VALUE" from the command line */
+int fru_vars_parse( struct fru_vars *vars, const char *assignment )
+{
+    char *copy, *eq;
+
+    copy = strdup( assignment );
+    eq = strchr( copy, '=' );
+    if( !eq || eq == copy )
+    {
+        free( copy );
+        return -1;
+    }
+    *eq = '\0';
+
+    return fru_vars_set( vars, copy, eq + 1 );
+}
+
+/* The builtins come first: a SEQ or UUID in the environment must not pin every unit */
+static const char *lookup_var( struct fru_vars *vars, const char *name, char *scratch )
+{
+    int i;
+
+    if( !strcmp( name, "SEQ" ) )
+    {
+        sprintf( scratch, "%lld", vars->seq );
+        return scratch;
+    }
+    if( !strcmp( name, "UUID" ) )
+    {
+        uint8_t uuid[UUID_BYTE_LENGTH];
+
+        fru_uuid_v4( uuid );
+        fru_uuid_format( uuid, scratch );
+        return scratch;
+    }
+
+    for( i = 0; i < vars->num; i++ )
+    {
+        if( !strcmp( vars->names[i], name ) )
+            return vars->values[i];
+    }
+
+    return getenv( name );
+}
+
+/* Accept "%[flags][width]conv" and rewrite it for a long long or a string */
+static int normalise_format( const char *fmt, int length, char *out, int size )
+{
+    char conv;
+    int i;
+
+    if( length < 2 || fmt[0] != '%' || length + 3 > size )
+        return -1;
+    for( i = 1; i < length - 1; i++ )
+    {
+        if( !strchr( "-+ 0#", fmt[i] ) && !isdigit( ( unsigned char ) fmt[i] ) )
+            return -1;
+    }
+    conv = fmt[length - 1];
+    if( !strchr( "duxXs", conv ) )
+        return -1;
+
+    snprintf( out, size, "%.*s%s%c", length - 1, fmt, conv == 's' ? "" : "ll", conv );
+
+    return 0;
+}
+
+static int parse_placeholder( struct fru_segment *seg, const char *p, int length )
+{
+    const char *colon, *sign;
+    char number[24];
+    int name_len;
+
+    colon = memchr( p, ':', length );
+    sign = NULL;
+    for( name_len = 0; name_len < ( colon ? colon - p : length ); name_len++ )
+    {
+        if( p[name_len] == '+' || p[name_len] == '-' )
+        {
+            sign = p + name_len;
+            break;
+        }
+    }
+    if( !name_len || name_len >= FRU_VAR_NAME_LENGTH )
+        return -1;
+    memcpy( seg->name, p, name_len );
+    seg->name[name_len] = '\0';
+
+    seg->delta = 0;
+    if( sign )
+    {
+        int num_len = ( colon ? colon : p + length ) - sign;
+
+        if( num_len < 2 || num_len >= ( int ) sizeof( number ) )
+            return -1;
+        memcpy( number, sign, num_len );
+        number[num_len] = '\0';
+        seg->delta = strtoll( number, NULL, 0 );
+    }
+
+    seg->format[0] = '\0';
+    seg->mac = colon && p + length - colon - 1 == 3 && !memcmp( colon + 1, "mac", 3 );
+    if( colon && !seg->mac && normalise_format( colon + 1, p + length - colon - 1,
+                                   seg->format, sizeof( seg->format ) ) )
+        return -1;
+
+    return 0;
+}
+
+/*
+ * Split source into literal and placeholder segments. Returns the number
+ * of placeholders, or -1 on a malformed one.
+ */
+int fru_template_compile( struct fru_template *t, const char *key, const char *source )
+{
+    const char *p, *start, *end;
+    struct fru_segment *seg;
+    int num_vars, max;
+
+    memset( t, 0, sizeof( *t ) );
+    t->key = key ? strdup( key ) : NULL;
+    t->source = strdup( source );
+
+    /* Every placeholder adds at most two segments */
+    max = 1;
+    for( p = t->source; ( p = strstr( p, "${" ) ) != NULL; p += 2 )
+        max += 2;
+    t->segments = ( struct fru_segment * ) calloc( max, sizeof( struct fru_segment ) );
+
+    num_vars = 0;
+    start = t->source;
+    while( *start )
+    {
+        seg = &t->segments[t->num_segments];
+        p = strstr( start, "${" );
+        if( p != start )
+        {
+            seg->text = start;
+            seg->length = p ? p - start : ( int ) strlen( start );
+            t->num_segments++;
+            if( !p )
+                break;
+            seg = &t->segments[t->num_segments];
+        }
+
+        end = strchr( p + 2, '}' );
+        if( !end || parse_placeholder( seg, p + 2, end - p - 2 ) )
+        {
+            fprintf( stderr, "\nInvalid placeholder in \"%s\"\n\n", source );
+            return -1;
+        }
+        seg->is_var = 1;
+        t->num_segments++;
+        num_vars++;
+        start = end + 1;
+    }
+
+    return num_vars;
+}
+
+/*
+ * Parse a MAC address: 12 hex digits, or six pairs separated by ':' or '-'
+ * (returned in sep, 0 for none). Returns 0 on success.
+ */
+static int parse_mac( const char *value, unsigned long long *mac, char *sep, int *lower )
+{
+    int i, j, k;
+
+    *mac = 0;
+    *lower = 0;
+    *sep = strlen( value ) == 17 ? value[2] : 0;
+    if( *sep && *sep != ':' && *sep != '-' )
+        return -1;
+    for( i = j = 0; i < 6; i++ )
+    {
+        if( i && *sep && value[j++] != *sep )
+            return -1;
+        if( !isxdigit( ( unsigned char ) value[j] ) || !isxdigit( ( unsigned char ) value[j + 1] ) )
+            return -1;
+        for( k = 0; k < 2; k++, j++ )
+        {
+            *lower |= islower( ( unsigned char ) value[j] ) != 0;
+            *mac = ( *mac << 4 ) | ( isdigit( ( unsigned char ) value[j] ) ? value[j] - '0' :
+                                     tolower( ( unsigned char ) value[j] ) - 'a' + 10 );
+        }
+    }
+
+    return value[j] == '\0' ? 0 : -1;
+}
+
+static int format_mac( unsigned long long mac, char sep, int lower, char *out, int size )
+{
+    const char *fmt;
+    unsigned b[6];
+    int i;
+
+    if( !sep )
+        return snprintf( out, size, lower ? "%012llx" : "%012llX", mac );
+
+    for( i = 0; i < 6; i++ )
+        b[i] = ( mac >> ( 40 - 8 * i ) ) & 0xff;
+    fmt = lower ? "%02x%c%02x%c%02x%c%02x%c%02x%c%02x" : "%02X%c%02X%c%02X%c%02X%c%02X%c%02X";
+    return snprintf( out, size, fmt, b[0], sep, b[1], sep, b[2], sep, b[3], sep, b[4], sep, b[5] );
+}
+
+static int expand_var( const struct fru_segment *seg, const char *value, char *out, int size )
+{
+    unsigned long long mac;
+    long long num;
+    char *end, sep;
+    int lower;
+
+    if( !seg->delta && !seg->format[0] && !seg->mac )
+        return snprintf( out, size, "%s", value );
+
+    if( seg->format[0] && seg->format[strlen( seg->format ) - 1] == 's' )
+        return snprintf( out, size, seg->format, value );
+
+    /* Hex arithmetic only for an explicit MAC, a 12-digit serial is decimal */
+    if( seg->mac || ( !seg->format[0] && strlen( value ) == 17 ) )
+    {
+        if( parse_mac( value, &mac, &sep, &lower ) )
+        {
+            if( seg->mac )
+            {
+                fprintf( stderr, "\n${%s}: \"%s\" is not a MAC address\n\n", seg->name, value );
+                return -1;
+            }
+        }
+        else
+            return format_mac( ( mac + seg->delta ) & 0xffffffffffffULL, sep, lower, out, size );
+    }
+
+    num = strtoll( value, &end, 10 );
+    if( *end || end == value )
+    {
+        fprintf( stderr, "\n${%s}: \"%s\" is not a number\n\n", seg->name, value );
+        return -1;
+    }
+    num += seg->delta;
+
+    return snprintf( out, size, seg->format[0] ? seg->format : "%lld", num );
+}
+
+/* Returns the expanded length, -1 on an unresolved variable or overflow */
+int fru_template_expand( const struct fru_template *t, struct fru_vars *vars,
+                         char *out, int size )
+{
+    const struct fru_segment *seg;
+    char scratch[64];
+    const char *value;
+    int pos, n, i;
+
+    pos = 0;
+    for( i = 0; i < t->num_segments; i++ )
+    {
+        seg = &t->segments[i];
+        if( !seg->is_var )
+        {
+            if( pos + seg->length >= size )
+                return -1;
+            memcpy( out + pos, seg->text, seg->length );
+            pos += seg->length;
+            continue;
+        }
+
+        value = lookup_var( vars, seg->name, scratch );
+        if( !value )
+        {
+            fprintf( stderr, "\nUndefined variable ${%s}%s%s\n\n", seg->name,
+                     t->key ? " in " : "", t->key ? t->key : "" );
+            return -1;
+        }
+        n = expand_var( seg, value, out + pos, size - pos );
+        if( n < 0 || pos + n >= size )
+            return -1;
+        pos += n;
+    }
+    out[pos] = '\0';
+
+    return pos;
+}
+
+void fru_template_free( struct fru_template *t )
+{
+    free( t->key );
+    free( t->source );
+    free( t->segments );
+}
+
+/* Pre-parse every config value that contains a placeholder */
+int fru_templates_compile( dictionary *ini, struct fru_templates *tmpl )
+{
+    struct fru_template t;
+    int i;
+
+    memset( tmpl, 0, sizeof( *tmpl ) );
+    for( i = 0; i < ini->size; i++ )
+    {
+        if( !ini->key[i] || !ini->val[i] || !strstr( ini->val[i], "${" ) )
+            continue;
+        if( fru_template_compile( &t, ini->key[i], ini->val[i] ) < 0 )
+            return -1;
+        tmpl->templates = ( struct fru_template * )
+                          realloc( tmpl->templates, ( tmpl->num + 1 ) * sizeof( t ) );
+        tmpl->templates[tmpl->num++] = t;
+    }
+
+    return tmpl->num;
+}
+
+/* Expand every template for one unit and store the result in the dictionary */
+int fru_templates_apply( dictionary *ini, const struct fru_templates *tmpl,
+                         struct fru_vars *vars )
+{
+    char value[1024];
+    int i;
+
+    for( i = 0; i < tmpl->num; i++ )
+    {
+        if( fru_template_expand( &tmpl->templates[i], vars, value, sizeof( value ) ) < 0 )
+            return -1;
+        dictionary_set( ini, tmpl->templates[i].key, value );
+    }
+
+    return 0;
+}
+
+/* Split a CSV line in place; double quotes protect commas, "" is a quote */
+static int split_csv( char *line, char **fields, int max )
+{
+    char *src, *dst;
+    int n, quoted;
+
+    n = 0;
+    src = line;
+    while( n < max )
+    {
+        fields[n++] = dst = src;
+        quoted = 0;
+        while( *src && ( quoted || *src != ',' ) )
+        {
+            if( *src == '"' )
+            {
+                if( quoted && src[1] == '"' )
+                {
+                    *dst++ = '"';
+                    src += 2;
+                    continue;
+                }
+                quoted = !quoted;
+                src++;
+                continue;
+            }
+            *dst++ = *src++;
+        }
+        if( !*src )
+        {
+            *dst = '\0';
+            break;
+        }
+        *dst = '\0';
+        src++;
+    }
+
+    return n;
+}
+
+static int read_line( struct fru_csv *csv )
+{
+    ssize_t len;
+
+    do
+    {
+        len = getline( &csv->line, &csv->line_size, csv->file );
+        if( len < 0 )
+            return -1;
+        csv->line_number++;
+        while( len > 0 && ( csv->line[len - 1] == '\n' || csv->line[len - 1] == '\r' ) )
+            csv->line[--len] = '\0';
+    }
+    while( !len );
+
+    return len;
+}
+
+/* The first line names the variables */
+int fru_csv_open( struct fru_csv *csv, const char *path )
+{
+    int i;
+
+    memset( csv, 0, sizeof( *csv ) );
+    if( ( csv->file = fopen( path, "r" ) ) == NULL )
+    {
+        perror( "CSV open:" );
+        return -1;
+    }
+    if( read_line( csv ) < 0 )
+    {
+        fprintf( stderr, "\nCSV file %s has no header line\n\n", path );
+        fclose( csv->file );
+        return -1;
+    }
+
+    csv->header = strdup( csv->line );
+    csv->num_columns = split_csv( csv->header, csv->names, FRU_MAX_VARS );
+    for( i = 0; i < csv->num_columns; i++ )
+    {
+        if( !strlen( csv->names[i] ) )
+        {
+            fprintf( stderr, "\nCSV file %s: empty column name\n\n", path );
+            fru_csv_close( csv );
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Load the next row into vars. Values point into the line buffer and stay
+ * valid until the following call. Returns 1 for a row, 0 at end of file.
+ */
+int fru_csv_next( struct fru_csv *csv, struct fru_vars *vars )
+{
+    char *fields[FRU_MAX_VARS];
+    int n, i;
+
+    if( read_line( csv ) < 0 )
+        return 0;
+
+    n = split_csv( csv->line, fields, FRU_MAX_VARS );
+    if( n != csv->num_columns )
+    {
+        fprintf( stderr, "\nCSV line %d: %d columns, expected %d\n\n",
+                 csv->line_number, n, csv->num_columns );
+        return -1;
+    }
+    for( i = 0; i < n; i++ )
+        fru_vars_set( vars, csv->names[i], fields[i] );
+
+    return 1;
+}
+
+void fru_csv_close( struct fru_csv *csv )
+{
+    fclose( csv->file );
+    free( csv->header );
+    free( csv->line );
+}
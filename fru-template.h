@@ -0,0 +1,90 @@
+#ifndef FRU_TEMPLATE_H
+#define FRU_TEMPLATE_H
+
+#include <stdio.h>
+
+#include "iniparser.h"
+
+/*
+ * Per-unit variable interpolation in config values
+ *
+ * Values may contain ${NAME}, ${NAME+N}, ${NAME-N} and ${NAME:FMT}
+ * placeholders, e.g. ${SERIAL}, ${MAC_BASE+4:mac} or ${SEQ:%06d}.
+ * Arithmetic is decimal, except on MAC addresses: values written as
+ * 00:11:22:33:44:55 (or with '-'), and any value under the :mac modifier,
+ * which also takes 12 bare hex digits. FMT is a printf conversion (d, u,
+ * x, X or s) with optional flags and width.
+ *
+ * Variables come from a CSV row, then -D NAME=VALUE, then the environment.
+ * SEQ (unit sequence number) and UUID (random, RFC 4122 version 4) are
+ * built in and cannot be overridden.
+ *
+ * Templates are split into literal and placeholder segments once, right
+ * after the config is parsed, so expanding them per unit is a plain
+ * concatenation.
+ */
+
+#define FRU_MAX_VARS        64
+#define FRU_VAR_NAME_LENGTH 32
+
+struct fru_vars
+{
+    int         num;
+    const char  *names[FRU_MAX_VARS];
+    const char  *values[FRU_MAX_VARS];
+    long long   seq;
+};
+
+struct fru_segment
+{
+    int         is_var;
+    const char  *text;      /* literal text, not nul-terminated */
+    int         length;
+    char        name[FRU_VAR_NAME_LENGTH];
+    long long   delta;
+    int         mac;        /* :mac, hex MAC address arithmetic */
+    char        format[16]; /* normalised to a long long / string conversion */
+};
+
+struct fru_template
+{
+    char                *key;       /* "section:key", NULL for free-standing templates */
+    char                *source;
+    int                 num_segments;
+    struct fru_segment  *segments;
+};
+
+struct fru_templates
+{
+    int                 num;
+    struct fru_template *templates;
+};
+
+struct fru_csv
+{
+    FILE        *file;
+    int         num_columns;
+    char        *header;
+    char        *names[FRU_MAX_VARS];
+    char        *line;
+    size_t      line_size;
+    int         line_number;
+};
+
+int fru_vars_set( struct fru_vars *vars, const char *name, const char *value );
+int fru_vars_parse( struct fru_vars *vars, const char *assignment );
+
+int fru_template_compile( struct fru_template *t, const char *key, const char *source );
+int fru_template_expand( const struct fru_template *t, struct fru_vars *vars,
+                         char *out, int size );
+void fru_template_free( struct fru_template *t );
+
+int fru_templates_compile( dictionary *ini, struct fru_templates *tmpl );
+int fru_templates_apply( dictionary *ini, const struct fru_templates *tmpl,
+                         struct fru_vars *vars );
+
+int fru_csv_open( struct fru_csv *csv, const char *path );
+int fru_csv_next( struct fru_csv *csv, struct fru_vars *vars );
+void fru_csv_close( struct fru_csv *csv );
+
+#endif
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "fru-stats.h"
+#include "fru-timeline.h"
+
+#ifdef FRU_STATS
+
+struct span
+{
+    const char  *name;
+    uint64_t    start;
+    uint64_t    end;
+};
+
+struct ring
+{
+    struct ring *next;
+    int         tid;
+    int         main;
+    uint64_t    head;       /* spans recorded so far */
+    struct span spans[FRU_TIMELINE_EVENTS];
+};
+
+static const char *timeline_path;
+static uint64_t timeline_start;
+static pthread_t main_thread;
+
+static struct ring *rings;
+static int num_rings;
+
+static __thread struct ring *ring;
+
+static struct ring *ring_create( void )
+{
+    struct ring *r;
+
+    /* Pages are only touched as spans fill them */
+    if( ( r = ( struct ring * ) calloc( 1, sizeof( struct ring ) ) ) == NULL )
+        return NULL;
+    r->tid = __atomic_add_fetch( &num_rings, 1, __ATOMIC_RELAXED );
+    r->main = pthread_equal( pthread_self(), main_thread );
+
+    r->next = __atomic_load_n( &rings, __ATOMIC_RELAXED );
+    while( !__atomic_compare_exchange_n( &rings, &r->next, r, 1, __ATOMIC_RELEASE,
+                                         __ATOMIC_RELAXED ) )
+        ;
+
+    return r;
+}
+
+void fru_timeline_span( const char *name, uint64_t start, uint64_t end )
+{
+    struct span *s;
+
+    if( !ring && ( ring = ring_create() ) == NULL )
+        return;
+
+    s = &ring->spans[ring->head & ( FRU_TIMELINE_EVENTS - 1 )];
+    s->name = name;
+    s->start = start;
+    s->end = end;
+    __atomic_store_n( &ring->head, ring->head + 1, __ATOMIC_RELEASE );
+}
+
+static void dump( void )
+{
+    uint64_t head, first, i, dropped;
+    const struct span *s;
+    const struct ring *r;
+    FILE *out;
+    int pid;
+
+    fru_stats_enabled &= ~FRU_STATS_TIMELINE;
+    if( ( out = fopen( timeline_path, "w" ) ) == NULL )
+    {
+        perror( "Trace open:" );
+        return;
+    }
+
+    pid = getpid();
+    dropped = 0;
+    fprintf( out, "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+             "\"args\":{\"name\":\"ipmi-fru-it\"}}", pid );
+    for( r = __atomic_load_n( &rings, __ATOMIC_ACQUIRE ); r; r = r->next )
+    {
+        fprintf( out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                 "\"args\":{\"name\":\"", pid, r->tid );
+        if( r->main )
+            fprintf( out, "main\"}}" );
+        else
+            fprintf( out, "worker %d\"}}", r->tid );
+
+        head = __atomic_load_n( &r->head, __ATOMIC_ACQUIRE );
+        first = head > FRU_TIMELINE_EVENTS ? head - FRU_TIMELINE_EVENTS : 0;
+        dropped += first;
+        for( i = first; i < head; i++ )
+        {
+            s = &r->spans[i & ( FRU_TIMELINE_EVENTS - 1 )];
+            fprintf( out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                     "\"ts\":%.3f,\"dur\":%.3f}", s->name, pid, r->tid,
+                     ( s->start - timeline_start ) / 1000.0, ( s->end - s->start ) / 1000.0 );
+        }
+    }
+    fprintf( out, "\n],\n\"displayTimeUnit\":\"ns\",\n\"otherData\":{\"dropped_spans\":%llu}}\n",
+             ( unsigned long long ) dropped );
+
+    fclose( out );
+}
+
+/* Write the trace to path when the process exits */
+int fru_timeline_enable( const char *path )
+{
+    timeline_path = path;
+    timeline_start = fru_stats_now();
+    main_thread = pthread_self();
+    fru_stats_enabled |= FRU_STATS_TIMELINE;
+    return atexit( dump );
+}
+
+#else
+
+int fru_timeline_enable( const char *path )
+{
+    fprintf( stderr, "\nError! --trace needs a build with STATS=1\n\n" );
+    return -1;
+}
+
+#endif
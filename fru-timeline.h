@@ -0,0 +1,27 @@
+#ifndef FRU_TIMELINE_H
+#define FRU_TIMELINE_H
+
+#include <inttypes.h>
+
+/*
+ * Timeline export (--trace FILE)
+ *
+ * While tracing, every --stats probe point (see fru-stats.h) also records a
+ * span: config parsing, each area and record encoder, MultiRecord
+ * checksums, image assembly, whole units, template expansion, serial
+ * patching, MAC pool allocation, file writes, EEPROM writes and fsync.
+ *
+ * Spans go into a ring buffer owned by the recording thread, so recording
+ * takes no lock; a ring is pushed onto the list of rings once, on its
+ * thread's first span. At exit all rings are written as Chrome trace event
+ * JSON, one track per thread, for ui.perfetto.dev or chrome://tracing. A
+ * thread that records more than FRU_TIMELINE_EVENTS spans keeps the most
+ * recent ones.
+ */
+
+#define FRU_TIMELINE_EVENTS     ( 1 << 18 )
+
+int fru_timeline_enable( const char *path );
+void fru_timeline_span( const char *name, uint64_t start, uint64_t end );
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef FRU_TRACE_H
+#define FRU_TRACE_H
+
+/*
+ * Static tracepoints (USDT)
+ *
+ * Built in whenever <sys/sdt.h> (systemtap-sdt-dev) is available, unless
+ * make USDT=0. A probe is a single nop in the code plus a note in the ELF
+ * file; it costs nothing until a tracer attaches, e.g.
+ *
+ *   bpftrace -l 'usdt:./ipmi-fru-it:*'
+ *   bpftrace -e 'usdt:./ipmi-fru-it:area__done { @[str(arg1)] = hist(arg2); }'
+ *   perf probe -x ipmi-fru-it sdt_ipmi_fru_it:unit__done
+ *
+ * Provider ipmi_fru_it, probes and arguments:
+ *
+ *   unit__start        unit
+ *   unit__done         unit, image length
+ *   area__start        unit, section ("cia", "bia", ...)
+ *   area__done         unit, section, area length
+ *   record__start      unit, section ("mia_mac", ...)
+ *   record__done       unit, section, record length
+ *   config__load       path
+ *   config__loaded     path, number of keys (-1 on a parse error)
+ *   write__start       path, length
+ *   write__done        path, length, 0 or -1
+ *   eeprom__write      offset, length
+ *
+ * unit numbers the images generated by the process, starting at 1.
+ */
+
+#if defined( __has_include ) && !defined( FRU_NO_USDT )
+#if __has_include( <sys/sdt.h> )
+#define FRU_USDT
+#endif
+#endif
+
+#ifdef FRU_USDT
+
+#include <sys/sdt.h>
+
+#define FRU_TRACE1( probe, a )          DTRACE_PROBE1( ipmi_fru_it, probe, a )
+#define FRU_TRACE2( probe, a, b )       DTRACE_PROBE2( ipmi_fru_it, probe, a, b )
+#define FRU_TRACE3( probe, a, b, c )    DTRACE_PROBE3( ipmi_fru_it, probe, a, b, c )
+
+#else
+
+#define FRU_TRACE1( probe, a )          do { } while( 0 )
+#define FRU_TRACE2( probe, a, b )       do { } while( 0 )
+#define FRU_TRACE3( probe, a, b, c )    do { } while( 0 )
+
+#endif
+
+#endif
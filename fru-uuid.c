@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+
+#include "fru-uuid.h"
+
+/* Nibble value of every byte, 0xff for non-hex characters */
+static const uint8_t hex_value[256] =
+{
+    [0 ... 255] = 0xff,
+    ['0'] = 0, ['1'] = 1, ['2'] = 2, ['3'] = 3, ['4'] = 4,
+    ['5'] = 5, ['6'] = 6, ['7'] = 7, ['8'] = 8, ['9'] = 9,
+    ['a'] = 10, ['b'] = 11, ['c'] = 12, ['d'] = 13, ['e'] = 14, ['f'] = 15,
+    ['A'] = 10, ['B'] = 11, ['C'] = 12, ['D'] = 13, ['E'] = 14, ['F'] = 15,
+};
+
+/* RFC 4122 appendix C */
+static const struct
+{
+    const char  *name;
+    uint8_t     uuid[UUID_BYTE_LENGTH];
+} namespaces[] =
+{
+    { "dns",  { 0x6b, 0xa7, 0xb8, 0x10, 0x9d, 0xad, 0x11, 0xd1,
+                0x80, 0xb4, 0x00, 0xc0, 0x4f, 0xd4, 0x30, 0xc8 } },
+    { "url",  { 0x6b, 0xa7, 0xb8, 0x11, 0x9d, 0xad, 0x11, 0xd1,
+                0x80, 0xb4, 0x00, 0xc0, 0x4f, 0xd4, 0x30, 0xc8 } },
+    { "oid",  { 0x6b, 0xa7, 0xb8, 0x12, 0x9d, 0xad, 0x11, 0xd1,
+                0x80, 0xb4, 0x00, 0xc0, 0x4f, 0xd4, 0x30, 0xc8 } },
+    { "x500", { 0x6b, 0xa7, 0xb8, 0x14, 0x9d, 0xad, 0x11, 0xd1,
+                0x80, 0xb4, 0x00, 0xc0, 0x4f, 0xd4, 0x30, 0xc8 } },
+};
+
+/* Canonical 8-4-4-4-12 form, case-insensitive. Returns 0 or -1. */
+int fru_uuid_parse( const char *str, uint8_t *uuid )
+{
+    const uint8_t *s = ( const uint8_t * ) str;
+    uint8_t hi, lo;
+    int i;
+
+    for( i = 0; i < UUID_BYTE_LENGTH; i++ )
+    {
+        if( i == 4 || i == 6 || i == 8 || i == 10 )
+        {
+            if( *s++ != '-' )
+                return -1;
+        }
+        hi = hex_value[s[0]];
+        lo = hi == 0xff ? 0xff : hex_value[s[1]];
+        if( lo == 0xff )
+            return -1;
+        uuid[i] = ( hi << 4 ) | lo;
+        s += 2;
+    }
+
+    return *s ? -1 : 0;
+}
+
+/* A UUID string or one of the well-known names dns, url, oid and x500 */
+int fru_uuid_namespace( const char *name, uint8_t *uuid )
+{
+    unsigned int i;
+
+    for( i = 0; i < sizeof( namespaces ) / sizeof( namespaces[0] ); i++ )
+    {
+        if( !strcmp( name, namespaces[i].name ) )
+        {
+            memcpy( uuid, namespaces[i].uuid, UUID_BYTE_LENGTH );
+            return 0;
+        }
+    }
+    return fru_uuid_parse( name, uuid );
+}
+
+void fru_uuid_format( const uint8_t *uuid, char *str )
+{
+    static const char digits[] = "0123456789abcdef";
+    int i;
+
+    for( i = 0; i < UUID_BYTE_LENGTH; i++ )
+    {
+        if( i == 4 || i == 6 || i == 8 || i == 10 )
+            *str++ = '-';
+        *str++ = digits[uuid[i] >> 4];
+        *str++ = digits[uuid[i] & 0x0f];
+    }
+    *str = '\0';
+}
+
+static void set_version( uint8_t *uuid, int version )
+{
+    uuid[6] = ( uuid[6] & 0x0f ) | ( version << 4 );
+    uuid[8] = ( uuid[8] & 0x3f ) | 0x80;
+}
+
+void fru_uuid_v4( uint8_t *uuid )
+{
+    static __thread uint8_t pool[4096];
+    static __thread int used = sizeof( pool );
+    int i;
+
+    if( used + UUID_BYTE_LENGTH > ( int ) sizeof( pool ) )
+    {
+        if( getrandom( pool, sizeof( pool ), 0 ) != sizeof( pool ) )
+        {
+            /* Not cryptographic, only needs to be unique enough */
+            for( i = 0; i < ( int ) sizeof( pool ); i++ )
+                pool[i] = rand();
+        }
+        used = 0;
+    }
+    memcpy( uuid, pool + used, UUID_BYTE_LENGTH );
+    used += UUID_BYTE_LENGTH;
+
+    set_version( uuid, 4 );
+}
+
+/* SHA-1 (FIPS 180-4), just enough for name-based UUIDs */
+struct sha1
+{
+    uint32_t    h[5];
+    uint8_t     block[64];
+    int         used;
+    uint64_t    length;
+};
+
+#define ROL( x, n ) ( ( ( x ) << ( n ) ) | ( ( x ) >> ( 32 - ( n ) ) ) )
+
+static void sha1_block( struct sha1 *ctx, const uint8_t *p )
+{
+    uint32_t w[80], a, b, c, d, e, f, k, t;
+    int i;
+
+    for( i = 0; i < 16; i++ )
+        w[i] = ( uint32_t ) p[4 * i] << 24 | p[4 * i + 1] << 16 | p[4 * i + 2] << 8 | p[4 * i + 3];
+    for( ; i < 80; i++ )
+        w[i] = ROL( w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1 );
+
+    a = ctx->h[0];
+    b = ctx->h[1];
+    c = ctx->h[2];
+    d = ctx->h[3];
+    e = ctx->h[4];
+    for( i = 0; i < 80; i++ )
+    {
+        if( i < 20 )
+        {
+            f = ( b & c ) | ( ~b & d );
+            k = 0x5a827999;
+        }
+        else if( i < 40 )
+        {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        }
+        else if( i < 60 )
+        {
+            f = ( b & c ) | ( b & d ) | ( c & d );
+            k = 0x8f1bbcdc;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        t = ROL( a, 5 ) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = ROL( b, 30 );
+        b = a;
+        a = t;
+    }
+    ctx->h[0] += a;
+    ctx->h[1] += b;
+    ctx->h[2] += c;
+    ctx->h[3] += d;
+    ctx->h[4] += e;
+}
+
+static void sha1_update( struct sha1 *ctx, const uint8_t *data, int length )
+{
+    ctx->length += length;
+    while( length-- )
+    {
+        ctx->block[ctx->used++] = *data++;
+        if( ctx->used == 64 )
+        {
+            sha1_block( ctx, ctx->block );
+            ctx->used = 0;
+        }
+    }
+}
+
+static void sha1_final( struct sha1 *ctx, uint8_t *digest )
+{
+    uint64_t bits = ctx->length * 8;
+    int i;
+
+    ctx->block[ctx->used++] = 0x80;
+    if( ctx->used > 56 )
+    {
+        memset( ctx->block + ctx->used, 0, 64 - ctx->used );
+        sha1_block( ctx, ctx->block );
+        ctx->used = 0;
+    }
+    memset( ctx->block + ctx->used, 0, 56 - ctx->used );
+    for( i = 0; i < 8; i++ )
+        ctx->block[56 + i] = bits >> ( 56 - 8 * i );
+    sha1_block( ctx, ctx->block );
+
+    for( i = 0; i < 20; i++ )
+        digest[i] = ctx->h[i / 4] >> ( 24 - 8 * ( i % 4 ) );
+}
+
+void fru_uuid_v5( const uint8_t *ns, const char *name, int length, uint8_t *uuid )
+{
+    struct sha1 ctx = { { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 },
+                        { 0 }, 0, 0 };
+    uint8_t digest[20];
+
+    sha1_update( &ctx, ns, UUID_BYTE_LENGTH );
+    sha1_update( &ctx, ( const uint8_t * ) name, length );
+    sha1_final( &ctx, digest );
+
+    memcpy( uuid, digest, UUID_BYTE_LENGTH );
+    set_version( uuid, 5 );
+}
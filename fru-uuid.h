@@ -0,0 +1,23 @@
+#ifndef FRU_UUID_H
+#define FRU_UUID_H
+
+#include <inttypes.h>
+
+#include "fru-defs.h"
+
+/*
+ * System UUIDs for the Management Access Record
+ *
+ * Version 4 UUIDs come from getrandom() through a per-thread buffer, so a
+ * batch costs one system call per few hundred units. Version 5 UUIDs are
+ * the SHA-1 of a namespace UUID and a name (normally the unit serial), so
+ * regenerating a unit reproduces its UUID. Bytes are kept in string order.
+ */
+
+int fru_uuid_parse( const char *str, uint8_t *uuid );
+int fru_uuid_namespace( const char *name, uint8_t *uuid );
+void fru_uuid_format( const uint8_t *uuid, char *str );
+void fru_uuid_v4( uint8_t *uuid );
+void fru_uuid_v5( const uint8_t *ns, const char *name, int length, uint8_t *uuid );
+
+#endif
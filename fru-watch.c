@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <poll.h>
+#include <time.h>
+#include <libgen.h>
+#include <sys/inotify.h>
+
+#include "fru-watch.h"
+#include "fru-config.h"
+#include "fru-reader.h"
+#include "fru-regen.h"
+#include "fru-stats.h"
+#include "fru-trace.h"
+
+#define WATCH_MAX_DEPS      65
+#define WATCH_MAX_RANGES    8
+
+struct watch_state
+{
+    int         fd;
+    int         num_deps;
+    char        deps[WATCH_MAX_DEPS][PATH_MAX];
+    int         num_dirs;
+    int         wds[WATCH_MAX_DEPS];
+    char        dirs[WATCH_MAX_DEPS][PATH_MAX];
+};
+
+static double elapsed_ms( const struct timespec *start )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( now.tv_sec - start->tv_sec ) * 1e3 + ( now.tv_nsec - start->tv_nsec ) / 1e6;
+}
+
+/* Write aside and rename into place */
+static int write_atomic( const char *path, const char *data, int length )
+{
+    char tmp[PATH_MAX];
+    int fd, done, ret;
+    FRU_STATS_START( start );
+    FRU_TRACE2( write__start, path, length );
+
+    snprintf( tmp, sizeof( tmp ), "%s.tmp", path );
+    if( ( fd = open( tmp, O_WRONLY | O_CREAT | O_TRUNC, S_IRWXU | S_IRGRP | S_IROTH ) ) == -1 )
+    {
+        perror( "File open:" );
+        FRU_TRACE3( write__done, path, length, -1 );
+        return -1;
+    }
+    for( done = 0; done < length; done += ret )
+    {
+        if( ( ret = write( fd, data + done, length - done ) ) <= 0 )
+        {
+            perror( "File write:" );
+            close( fd );
+            unlink( tmp );
+            FRU_TRACE3( write__done, path, length, -1 );
+            return -1;
+        }
+    }
+    close( fd );
+
+    if( rename( tmp, path ) )
+    {
+        perror( "File rename:" );
+        unlink( tmp );
+        FRU_TRACE3( write__done, path, length, -1 );
+        return -1;
+    }
+    FRU_STATS_COUNT( FRU_STAT_BYTES_WRITTEN, length );
+    FRU_STATS_COUNT( FRU_STAT_FILES_WRITTEN, 1 );
+    FRU_TRACE3( write__done, path, length, 0 );
+    FRU_STATS_STAGE( "write", start );
+    return 0;
+}
+
+static void add_dep( struct watch_state *ws, const char *path )
+{
+    char real[PATH_MAX], copy[PATH_MAX], *dir;
+    int i;
+
+    /* A dependency that does not exist yet is watched under the name given */
+    if( !realpath( path, real ) )
+        snprintf( real, sizeof( real ), "%s", path );
+    for( i = 0; i < ws->num_deps; i++ )
+    {
+        if( !strcmp( ws->deps[i], real ) )
+            return;
+    }
+    if( ws->num_deps == WATCH_MAX_DEPS )
+        return;
+    snprintf( ws->deps[ws->num_deps++], PATH_MAX, "%s", real );
+
+    snprintf( copy, sizeof( copy ), "%s", real );
+    dir = dirname( copy );
+    for( i = 0; i < ws->num_dirs; i++ )
+    {
+        if( !strcmp( ws->dirs[i], dir ) )
+            return;
+    }
+    ws->wds[ws->num_dirs] = inotify_add_watch( ws->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO |
+                                               IN_CREATE | IN_DELETE | IN_ATTRIB );
+    if( ws->wds[ws->num_dirs] < 0 )
+    {
+        fprintf( stderr, "Cannot watch %s: %s\n", dir, strerror( errno ) );
+        return;
+    }
+    snprintf( ws->dirs[ws->num_dirs++], PATH_MAX, "%s", dir );
+}
+
+static void add_build_deps( struct watch_state *ws, const char *extra_dep )
+{
+    const char **files;
+    int num, i;
+
+    num = fru_config_files( &files );
+    for( i = 0; i < num; i++ )
+        add_dep( ws, files[i] );
+    if( extra_dep )
+        add_dep( ws, extra_dep );
+}
+
+/* Name of the dependency an event is about, NULL if it is about something else */
+static const char *event_dep( struct watch_state *ws, const struct inotify_event *ev )
+{
+    char path[PATH_MAX + NAME_MAX + 2];
+    int i;
+
+    if( !ev->len )
+        return NULL;
+    for( i = 0; i < ws->num_dirs; i++ )
+    {
+        if( ws->wds[i] == ev->wd )
+            break;
+    }
+    if( i == ws->num_dirs )
+        return NULL;
+
+    snprintf( path, sizeof( path ), "%s/%s", ws->dirs[i], ev->name );
+    for( i = 0; i < ws->num_deps; i++ )
+    {
+        if( !strcmp( ws->deps[i], path ) )
+            return ws->deps[i];
+    }
+    return NULL;
+}
+
+/* Wait for a change to a dependency, then swallow the rest of the burst */
+static const char *wait_change( struct watch_state *ws )
+{
+    char buf[16 * 1024] __attribute__( ( aligned( __alignof__( struct inotify_event ) ) ) );
+    const struct inotify_event *ev;
+    const char *changed, *dep;
+    struct pollfd pfd;
+    ssize_t len;
+    char *p;
+
+    changed = NULL;
+    pfd.fd = ws->fd;
+    pfd.events = POLLIN;
+    while( !changed || poll( &pfd, 1, 0 ) > 0 )
+    {
+        len = read( ws->fd, buf, sizeof( buf ) );
+        if( len <= 0 )
+        {
+            if( len < 0 && errno == EINTR )
+                continue;
+            return changed;
+        }
+        for( p = buf; p < buf + len; p += sizeof( struct inotify_event ) + ev->len )
+        {
+            ev = ( const struct inotify_event * ) p;
+            if( ( dep = event_dep( ws, ev ) ) != NULL && !changed )
+                changed = dep;
+        }
+    }
+    return changed;
+}
+
+/* "area.field" holding an offset of the new image */
+static void region_name( struct fru_image *img, int offset, char *out, int size )
+{
+    struct fru_area *a;
+    struct fru_field *f;
+    int i, j;
+
+    if( offset < ( int ) sizeof( struct fru_common_header ) )
+    {
+        snprintf( out, size, "header" );
+        return;
+    }
+    for( i = 0; i < FRU_AREA_NUM; i++ )
+    {
+        a = &img->areas[i];
+        if( !a->present || offset < a->offset || offset >= a->offset + a->length )
+            continue;
+        for( j = 0; j < a->num_fields; j++ )
+        {
+            f = &a->fields[j];
+            if( offset >= f->offset && offset < f->offset + f->length + !f->fixed )
+            {
+                if( f->name )
+                    snprintf( out, size, "%s.%s", fru_area_name( i ), f->name );
+                else
+                    snprintf( out, size, "%s.custom_%d", fru_area_name( i ), f->custom + 1 );
+                return;
+            }
+        }
+        snprintf( out, size, "%s%s", fru_area_name( i ),
+                  offset == a->cksum_offset ? " checksum" : "" );
+        return;
+    }
+    for( i = 0; i < img->num_records; i++ )
+    {
+        if( offset >= img->records[i].offset &&
+            offset < img->records[i].offset + ( int ) sizeof( struct multi_record_header ) +
+                     img->records[i].length )
+        {
+            snprintf( out, size, "record 0x%02x", img->records[i].type_id );
+            return;
+        }
+    }
+    snprintf( out, size, "padding" );
+}
+
+static void print_summary( const char *changed, const uint8_t *old, int old_length,
+                           const uint8_t *image, int length, double ms )
+{
+    int starts[WATCH_MAX_RANGES], ends[WATCH_MAX_RANGES];
+    int num_ranges, more, bytes, common, i;
+    struct fru_image img;
+    char name[64];
+
+    common = old_length < length ? old_length : length;
+    bytes = abs( length - old_length );
+    num_ranges = more = 0;
+    for( i = 0; i < common; i++ )
+    {
+        if( old[i] == image[i] )
+            continue;
+        bytes++;
+        if( num_ranges && ends[num_ranges - 1] >= i - 1 )
+            ends[num_ranges - 1] = i;
+        else if( num_ranges < WATCH_MAX_RANGES )
+        {
+            starts[num_ranges] = ends[num_ranges] = i;
+            num_ranges++;
+        }
+        else if( old[i - 1] == image[i - 1] )
+            more++;
+    }
+
+    fprintf( stdout, "%s: %d byte%s changed", changed, bytes, bytes == 1 ? "" : "s" );
+    if( length != old_length )
+        fprintf( stdout, ", length %d -> %d", old_length, length );
+    if( regen_cache )
+        fprintf( stdout, ", %d re-encoded, %d reused%s", regen_cache->encoded,
+                 regen_cache->reused, regen_cache->relaid ? ", relaid" : "" );
+    fprintf( stdout, ", %.3f ms\n", ms );
+
+    fru_read_image( image, length, &img );
+    for( i = 0; i < num_ranges; i++ )
+    {
+        region_name( &img, starts[i], name, sizeof( name ) );
+        fprintf( stdout, "    0x%04x-0x%04x  %s\n", starts[i], ends[i], name );
+    }
+    if( more )
+        fprintf( stdout, "    ... %d more\n", more );
+    fflush( stdout );
+}
+
+/* Never returns unless the watch cannot be set up */
+int fru_watch_run( struct fru_watch *w )
+{
+    struct watch_state *ws;
+    struct timespec start;
+    const char *changed, *extra_dep;
+    char *image, *old;
+    int length, old_length;
+
+    ws = ( struct watch_state * ) calloc( 1, sizeof( *ws ) );
+    if( ( ws->fd = inotify_init1( IN_CLOEXEC ) ) < 0 )
+    {
+        perror( "inotify:" );
+        free( ws );
+        return -1;
+    }
+
+    old = NULL;
+    old_length = 0;
+    changed = "initial build";
+    for( ;; )
+    {
+        clock_gettime( CLOCK_MONOTONIC, &start );
+        extra_dep = NULL;
+        length = w->build( w->ctx, &image, &extra_dep );
+
+        /* Files named by a broken build are still worth watching */
+        add_build_deps( ws, extra_dep );
+
+        if( length < 0 )
+        {
+            fprintf( stdout, "%s: build failed, keeping %s\n", changed, w->outfile );
+            fflush( stdout );
+        }
+        else if( write_atomic( w->outfile, image, length ) == 0 )
+        {
+            print_summary( changed, ( uint8_t * ) old, old ? old_length : 0,
+                           ( uint8_t * ) image, length, elapsed_ms( &start ) );
+            free( old );
+            old = image;
+            old_length = length;
+        }
+        else
+            free( image );
+
+        if( ( changed = wait_change( ws ) ) == NULL )
+            break;
+    }
+
+    close( ws->fd );
+    free( ws );
+    free( old );
+
+    return -1;
+}
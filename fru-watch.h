@@ -0,0 +1,25 @@
+#ifndef FRU_WATCH_H
+#define FRU_WATCH_H
+
+/*
+ * Watch mode
+ *
+ * The image is rebuilt whenever one of its inputs changes: every config
+ * file merged by the last build (bases included) plus the IUA bin_file.
+ * Directories are watched rather than files, so editors that save by
+ * renaming a new file into place are followed too. Each build goes to a
+ * temporary file renamed over the output, so readers never see a partial
+ * image, and a byte-level summary of the change is printed.
+ */
+
+struct fru_watch
+{
+    const char  *outfile;
+    /* Returns the image length or -1; *extra_dep is an input besides the configs */
+    int         ( *build )( void *ctx, char **data, const char **extra_dep );
+    void        *ctx;
+};
+
+int fru_watch_run( struct fru_watch *w );
+
+#endif
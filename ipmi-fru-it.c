@@ -1,15 +1,38 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <fcntl.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 
 #include "iniparser.h"
+#include "ipmi-fru-it.h"
 #include "fru-defs.h"
+#include "fru-alloc.h"
+#include "fru-eeprom.h"
+#include "fru-layout.h"
+#include "fru-manifest.h"
+#include "fru-patch.h"
+#include "fru-reader.h"
+#include "fru-template.h"
+#include "fru-trace.h"
+#include "fru-batch.h"
+#include "fru-binfile.h"
+#include "fru-config.h"
+#include "fru-decode.h"
+#include "fru-diff.h"
+#include "fru-macpool.h"
+#include "fru-regen.h"
+#include "fru-scan.h"
+#include "fru-stats.h"
+#include "fru-timeline.h"
+#include "fru-uuid.h"
+#include "fru-watch.h"
 
 #define TOOL_VERSION "0.2"
 
@@ -18,13 +41,59 @@ char usage[] =
     "OPTIONS:\n"
     "\t-h\t\tThis help text\n"
     "\t-v\t\tPrint version and exit\n"
-    "\t-r\t\tRead FRU data from file specified by -i\n"
-    "\t-i FILE\t\tFRU data file (use with -r)\n"
+    "\t-r\t\tDecode the FRU data files given by -i or as arguments\n"
+    "\t-i FILE\t\tFRU data file (use with -r, repeatable); \"-\" reads one\n"
+    "\t\t\tfile name per line from stdin\n"
+    "\t--format FMT\tOutput of -r, to -o FILE or stdout: \"text\" (default),\n"
+    "\t\t\t\"json\" (one object per image and line) or \"ini\", a config\n"
+    "\t\t\tthat rebuilds the same images (a multi-FRU one for several)\n"
     "\t-w\t\tWrite FRU data to file specified in -o\n"
-    "\t-c FILE\t\tFRU Config file\n"
+    "\t-c FILE\t\tFRU Config file; repeat to overlay configs (last wins)\n"
     "\t-s SIZE\t\tMaximum file size (in bytes) allowed for the FRU data file\n"
     "\t-a\t\tUse 8-bit ASCII\n"
-    "\t-o FILE\t\tOutput FRU data filename (use with -w)\n\n";
+    "\t--diff EXPECTED ACTUAL\n"
+    "\t\t\tCompare FRU images field by field; ACTUAL may be a directory\n"
+    "\t\t\tof dumps, compared on -j threads\n"
+    "\t--scan FILE\tFind FRU images in a raw flash/EEPROM dump and print their\n"
+    "\t\t\toffsets; with -o DIR they are saved there as OFFSET.bin\n"
+    "\t-o FILE\t\tOutput FRU data filename (use with -w), may contain ${VAR}\n"
+    "\t-D NAME=VALUE\tDefine a variable for ${NAME} placeholders in config values\n"
+    "\t--csv FILE\tBuild one image per CSV row; the header line names the\n"
+    "\t\t\tvariables, -o must contain a placeholder such as ${SERIAL}\n"
+    "\t--seq N\t\tFirst value of the built-in ${SEQ} unit counter (default 1)\n"
+    "\t--serial-range PATTERN START COUNT\n"
+    "\t\t\tBuild COUNT images with serials PATTERN (e.g. ABC%%08d) from\n"
+    "\t\t\tSTART by patching the serial slots of one golden image;\n"
+    "\t\t\t-o must contain ${SERIAL} or ${SEQ}\n"
+    "\t-j N\t\tWorker threads for --serial-range and multi-FRU configs\n"
+    "\t\t\t(default 1)\n"
+    "\t--device PATH\tProgram the FRU data straight into an EEPROM (at24 sysfs\n"
+    "\t\t\tnode, loop device or plain file), writing only changed pages\n"
+    "\t--page-size N\tEEPROM page size in bytes (default 8)\n"
+    "\t--layout MODE\tArea placement: \"packed\" (default) or \"hot-cold\", which\n"
+    "\t\t\tgroups per-unit fields into as few EEPROM pages as possible\n"
+    "\t--reserve N\tGrowth padding in bytes for areas with per-unit fields\n"
+    "\t\t\t(use with --layout hot-cold)\n"
+    "\t--layout-report\tPrint the EEPROM pages touched by each per-unit field\n"
+    "\t--manifest FILE\tWrite a JSON manifest of every field slot (offset,\n"
+    "\t\t\tcapacity, encoding, covering checksum) of the generated image\n"
+    "\t--patch IMAGE\tUpdate fields of an existing FRU image in place\n"
+    "\t--set AREA:KEY=VALUE\n"
+    "\t\t\tField to update with --patch, e.g. bia:serial_number=XYZ;\n"
+    "\t\t\tcustom fields are custom_1, custom_2, ... (repeatable)\n"
+    "\t--mac-pool FILE\tAllocate the mia_mac base addresses of every unit from a\n"
+    "\t\t\tMAC pool file shared by parallel workers and processes\n"
+    "\t--mac-pool-create SPEC\n"
+    "\t\t\tCreate the --mac-pool file for OUI (e.g. 001122) or\n"
+    "\t\t\tOUI:FIRST-LAST (e.g. 001122:100000-1fffff)\n"
+    "\t--mac-pool-chunk N\tAddresses reserved from the pool at once (default:\n"
+    "\t\t\texactly one unit, 4096 for --csv and --serial-range)\n"
+    "\t--watch\t\tStay running and rebuild -o whenever the config, a file it\n"
+    "\t\t\tinherits or the IUA bin_file changes\n"
+    "\t--stats[=FILE]\tPrint stage timings, counters and per-unit histograms\n"
+    "\t\t\tas JSON on exit, to FILE or stderr\n"
+    "\t--trace FILE\tWrite a per-thread timeline of the run to FILE as Chrome\n"
+    "\t\t\ttrace JSON (ui.perfetto.dev, chrome://tracing)\n\n";
 
 /* Std IPMI FRU Section headers */
 const char *IUA = "iua";
@@ -77,6 +146,8 @@ const char* RECORD_TYPE_ID       = "type_id";
 const char* RECORD_FORMAT_VERSION    = "format_version";
 const char* SUB_RECORD_TYPE      = "sub_type";
 const char* RECORD_DATA          = "record_data";
+const char* UUID_NAMESPACE       = "uuid_namespace";
+const char* UUID_NAME            = "uuid_name";
 
 const char* OEM_MAJOR_VER        = "oem_vpd_major_version";
 const char* OEM_MINOR_VER        = "oem_vpd_minor_version";
@@ -99,6 +170,40 @@ const char* CONTROLLER_TYPE      = "controller_type";
 
 const char* CUSTOMER_ID          = "customer_id";
 
+const char* OVERALL_CAPACITY     = "overall_capacity";
+const char* PEAK_VA              = "peak_va";
+const char* INRUSH_CURRENT       = "inrush_current";
+const char* INRUSH_INTERVAL      = "inrush_interval";
+const char* LOW_INPUT_VOLTAGE_1  = "low_input_voltage_1";
+const char* HIGH_INPUT_VOLTAGE_1 = "high_input_voltage_1";
+const char* LOW_INPUT_VOLTAGE_2  = "low_input_voltage_2";
+const char* HIGH_INPUT_VOLTAGE_2 = "high_input_voltage_2";
+const char* LOW_INPUT_FREQUENCY  = "low_input_frequency";
+const char* HIGH_INPUT_FREQUENCY = "high_input_frequency";
+const char* AC_DROPOUT_TOLERANCE = "ac_dropout_tolerance";
+const char* PREDICTIVE_FAIL_PIN  = "predictive_fail_pin";
+const char* POWER_FACTOR_CORRECTION = "power_factor_correction";
+const char* AUTOSWITCH           = "autoswitch";
+const char* HOT_SWAP             = "hot_swap";
+const char* PREDICTIVE_FAIL_TACH = "predictive_fail_tach";
+const char* PEAK_CAPACITY        = "peak_capacity";
+const char* HOLD_UP_TIME         = "hold_up_time";
+const char* COMBINED_VOLTAGE_1   = "combined_voltage_1";
+const char* COMBINED_VOLTAGE_2   = "combined_voltage_2";
+const char* COMBINED_WATTAGE     = "combined_wattage";
+const char* TACH_LOWER_THRESHOLD = "tach_lower_threshold";
+
+const char* OUTPUT_NUMBER        = "output_number";
+const char* STANDBY              = "standby";
+const char* NOMINAL_VOLTAGE      = "nominal_voltage";
+const char* MAX_NEGATIVE_DEVIATION = "max_negative_deviation";
+const char* MAX_POSITIVE_DEVIATION = "max_positive_deviation";
+const char* MIN_VOLTAGE          = "min_voltage";
+const char* MAX_VOLTAGE          = "max_voltage";
+const char* RIPPLE_NOISE         = "ripple_noise";
+const char* MIN_CURRENT          = "min_current";
+const char* MAX_CURRENT          = "max_current";
+
 
 int ( *packer )( const char *, char ** );
 int ( *packerascii )( const char *, int, char ** );
@@ -109,7 +214,7 @@ uint8_t get_6bit_ascii( char c )
     return ( c - 0x20 ) & 0x3f;
 }
 
-uint8_t get_aligned_size( uint8_t size, uint8_t align )
+int get_aligned_size( int size, int align )
 {
     return ( size + align - 1 ) & ~( align - 1 );
 }
@@ -124,7 +229,7 @@ uint8_t get_fru_tl_length( struct fru_type_length *ftl )
     return ftl->type_length & 0x3f;
 }
 
-uint8_t get_zero_cksum( uint8_t *data, int num_bytes )
+uint8_t get_zero_cksum( const uint8_t *data, int num_bytes )
 {
     int sum = 0;
     while( num_bytes-- )
@@ -163,6 +268,10 @@ int pack_ascii8_length( const char *str, int type_length, char **raw_data )
 
     uint8_t numbytes = type_length & 0x3f;
 
+    /* C1h is the end-of-fields marker, a single character is padded to two */
+    if( numbytes == 1 )
+        numbytes = 2;
+
     /* Set length. It can be a max of 64 bytes */
     tl |= numbytes;
 
@@ -261,17 +370,42 @@ int pack_ascii6( const char *str, char **raw_data )
     return size;
 }
 
+/* The IUA bin_file as input_hash() found it, gen_iua() maps it without another stat() */
+static __thread struct stat bin_file_stat;
+static __thread int bin_file_stat_valid;
+
 /* All gen_* functions, except gen_iua(), return size as multiples of 8 */
 int gen_iua( dictionary *ini, char **iua_data )
 {
+    const struct fru_binfile *bf;
     int cksum, size;
-    char *data;
+    char *data, *bin_file;
     struct internal_use_area *iua;
 
     /* initialize some sane values */
     cksum = size = 0;
     data = NULL;
 
+    /* Vendor blob: format version followed by the file, padded to 8 bytes */
+    bin_file = fru_config_getstring( ini, get_key( IUA, BINFILE ), NULL );
+    if( bin_file && strlen( bin_file ) )
+    {
+        if( ( bf = fru_binfile_map( bin_file, bin_file_stat_valid ? &bin_file_stat : NULL ) ) == NULL )
+        {
+            fprintf( stderr, "\nError! Cannot read IUA bin_file %s\n\n", bin_file );
+            return -1;
+        }
+        size = ( 1 + bf->size + 7 ) & ~7;
+        data = ( char * ) malloc( size );
+        data[0] = 0x01;
+        if( bf->size )
+            memcpy( data + 1, bf->data, bf->size );
+        memset( data + 1 + bf->size, 0, size - 1 - bf->size );
+
+        *iua_data = data;
+        return size;
+    }
+
     size = sizeof( struct internal_use_area );
     data = ( char * ) calloc( size, 1 );
 
@@ -326,19 +460,19 @@ int gen_cia( dictionary *ini, char **cia_data )
     size = offset = cksum = empty_marker = key_size = 0;
     end_marker = 0xc1;
 
-    chassis_type = iniparser_getint( ini, get_key( CIA, CHASSIS_TYPE ), 0 );
+    chassis_type = fru_config_getint( ini, get_key( CIA, CHASSIS_TYPE ), 0 );
     if( !chassis_type )
     {
         /* 0 is an illegal chassis type */
-        fprintf( stderr, "\nInvalid chassis type! Aborting\n\n" );
-        exit( EXIT_FAILURE );
+        fprintf( stderr, "\nInvalid chassis type!\n\n" );
+        return -1;
     }
     size += sizeof( struct chassis_info_area );
 
-    str_data = iniparser_getstring( ini, get_key( CIA, PART_NUMBER ), NULL );
+    str_data = fru_config_getstring( ini, get_key( CIA, PART_NUMBER ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( CIA, PART_NUMBER_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( CIA, PART_NUMBER_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         part_num_size = ( *packerascii )( str_data, key_size, &part_num_packed );
@@ -351,10 +485,10 @@ int gen_cia( dictionary *ini, char **cia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( CIA, SERIAL_NUMBER ), NULL );
+    str_data = fru_config_getstring( ini, get_key( CIA, SERIAL_NUMBER ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( CIA, SERIAL_NUMBER_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( CIA, SERIAL_NUMBER_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         serial_num_size = ( *packerascii )( str_data, key_size, &serial_num_packed );
@@ -367,10 +501,10 @@ int gen_cia( dictionary *ini, char **cia_data )
     }
 
 
-    str_data = iniparser_getstring( ini, get_key( CIA, PRODUCT_NAME ), NULL );
+    str_data = fru_config_getstring( ini, get_key( CIA, PRODUCT_NAME ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( CIA, PRODUCT_NAME_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( CIA, PRODUCT_NAME_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         name_size = ( *packerascii )( str_data, key_size, &name_packed );
@@ -382,10 +516,10 @@ int gen_cia( dictionary *ini, char **cia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( CIA, SKU_ID ), NULL );
+    str_data = fru_config_getstring( ini, get_key( CIA, SKU_ID ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( CIA, SKU_ID_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( CIA, SKU_ID_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         skuid_size = ( *packerascii )( str_data, key_size, &skuid_packed );
@@ -397,10 +531,10 @@ int gen_cia( dictionary *ini, char **cia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( CIA, MANUFACTURER ), NULL );
+    str_data = fru_config_getstring( ini, get_key( CIA, MANUFACTURER ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( CIA, MANUFACTURER_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( CIA, MANUFACTURER_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         manufacturer_size = ( *packerascii )( str_data, key_size, &manufacturer_packed );
@@ -412,10 +546,10 @@ int gen_cia( dictionary *ini, char **cia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( CIA, VERSION ), NULL );
+    str_data = fru_config_getstring( ini, get_key( CIA, VERSION ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( CIA, VERSION_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( CIA, VERSION_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         version_size = ( *packerascii )( str_data, key_size, &version_packed );
@@ -427,10 +561,10 @@ int gen_cia( dictionary *ini, char **cia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( CIA, ASSET_TAG ), NULL );
+    str_data = fru_config_getstring( ini, get_key( CIA, ASSET_TAG ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( CIA, ASSET_TAG_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( CIA, ASSET_TAG_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         asset_tag_size = ( *packerascii )( str_data, key_size, &asset_tag_packed );
@@ -442,8 +576,8 @@ int gen_cia( dictionary *ini, char **cia_data )
         size += 1;
     }
 
-    num_keys = iniparser_getsecnkeys( ini, CIA );
-    sec_keys = iniparser_getseckeys( ini, CIA );
+    num_keys = fru_config_getsecnkeys( ini, CIA );
+    sec_keys = fru_config_getseckeys( ini, CIA );
 
     for( i = 0; i < num_keys; i++ )
     {
@@ -468,7 +602,7 @@ int gen_cia( dictionary *ini, char **cia_data )
         {
             continue;
         }
-        str_data = iniparser_getstring( ini, key, NULL );
+        str_data = fru_config_getstring( ini, key, NULL );
         if( str_data && strlen( str_data ) )
         {
             size += ( *packer )( str_data, &packed_ascii );
@@ -590,7 +724,7 @@ int gen_cia( dictionary *ini, char **cia_data )
 
             continue;
         }
-        str_data = iniparser_getstring( ini, key, NULL );
+        str_data = fru_config_getstring( ini, key, NULL );
         if( str_data && strlen( str_data ) )
         {
             packed_size = ( *packer )( str_data, &packed_ascii );
@@ -653,7 +787,7 @@ int gen_bia( dictionary *ini, char **bia_data )
     size = offset = cksum = empty_marker = 0;
     end_marker = 0xc1;
 
-    lang_code = iniparser_getint( ini, get_key( BIA, LANGUAGE_CODE ), -1 );
+    lang_code = fru_config_getint( ini, get_key( BIA, LANGUAGE_CODE ), -1 );
     if( lang_code == -1 )
     {
         fprintf( stdout, "Board language code not specified. "
@@ -661,7 +795,7 @@ int gen_bia( dictionary *ini, char **bia_data )
         lang_code = 0;
     }
 
-    mfg_date = iniparser_getint( ini, get_key( BIA, MFG_DATETIME ), -1 );
+    mfg_date = fru_config_getint( ini, get_key( BIA, MFG_DATETIME ), -1 );
     if( mfg_date == -1 )
     {
         fprintf( stdout, "Manufacturing time not specified. "
@@ -673,10 +807,10 @@ int gen_bia( dictionary *ini, char **bia_data )
     }
     size += sizeof( struct board_info_area );
 
-    str_data = iniparser_getstring( ini, get_key( BIA, MANUFACTURER ), NULL );
+    str_data = fru_config_getstring( ini, get_key( BIA, MANUFACTURER ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( BIA, MANUFACTURER_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( BIA, MANUFACTURER_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         mfg_size = ( *packerascii )( str_data, key_size, &mfg_packed );
@@ -688,10 +822,10 @@ int gen_bia( dictionary *ini, char **bia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( BIA, PRODUCT_NAME ), NULL );
+    str_data = fru_config_getstring( ini, get_key( BIA, PRODUCT_NAME ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( BIA, PRODUCT_NAME_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( BIA, PRODUCT_NAME_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         name_size = ( *packerascii )( str_data, key_size, &name_packed );
@@ -703,10 +837,10 @@ int gen_bia( dictionary *ini, char **bia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( BIA, SERIAL_NUMBER ), NULL );
+    str_data = fru_config_getstring( ini, get_key( BIA, SERIAL_NUMBER ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( BIA, SERIAL_NUMBER_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( BIA, SERIAL_NUMBER_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         serial_num_size = ( *packerascii )( str_data, key_size, &serial_num_packed );
@@ -718,10 +852,10 @@ int gen_bia( dictionary *ini, char **bia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( BIA, PART_NUMBER ), NULL );
+    str_data = fru_config_getstring( ini, get_key( BIA, PART_NUMBER ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( BIA, PART_NUMBER_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( BIA, PART_NUMBER_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         part_num_size = ( *packerascii )( str_data, key_size, &part_num_packed );
@@ -733,10 +867,10 @@ int gen_bia( dictionary *ini, char **bia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( BIA, FRU_FILE_ID ), NULL );
+    str_data = fru_config_getstring( ini, get_key( BIA, FRU_FILE_ID ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( BIA, FRU_FILE_ID_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( BIA, FRU_FILE_ID_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         fru_file_id_size = ( *packerascii )( str_data, key_size, &fru_file_id_packed );
@@ -748,10 +882,10 @@ int gen_bia( dictionary *ini, char **bia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( BIA, VERSION ), NULL );
+    str_data = fru_config_getstring( ini, get_key( BIA, VERSION ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( BIA, VERSION_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( BIA, VERSION_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         version_size = ( *packerascii )( str_data, key_size, &version_packed );
@@ -763,10 +897,10 @@ int gen_bia( dictionary *ini, char **bia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( BIA, ASSET_TAG ), NULL );
+    str_data = fru_config_getstring( ini, get_key( BIA, ASSET_TAG ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( BIA, ASSET_TAG_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( BIA, ASSET_TAG_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         asset_tag_size = ( *packerascii )( str_data, key_size, &asset_tag_packed );
@@ -782,8 +916,8 @@ int gen_bia( dictionary *ini, char **bia_data )
     /* We don't handle FRU File ID for now... */
     //size += 1;
 
-    num_keys = iniparser_getsecnkeys( ini, BIA );
-    sec_keys = iniparser_getseckeys( ini, BIA );
+    num_keys = fru_config_getsecnkeys( ini, BIA );
+    sec_keys = fru_config_getseckeys( ini, BIA );
 
     for( i = 0; i < num_keys; i++ )
     {
@@ -808,7 +942,7 @@ int gen_bia( dictionary *ini, char **bia_data )
         {
             continue;
         }
-        str_data = iniparser_getstring( ini, key, NULL );
+        str_data = fru_config_getstring( ini, key, NULL );
         if( str_data && strlen( str_data ) )
         {
             size += ( *packer )( str_data, &packed_ascii );
@@ -933,7 +1067,7 @@ int gen_bia( dictionary *ini, char **bia_data )
         {
             continue;
         }
-        str_data = iniparser_getstring( ini, key, NULL );
+        str_data = fru_config_getstring( ini, key, NULL );
         if( str_data && strlen( str_data ) )
         {
             packed_size = ( *packer )( str_data, &packed_ascii );
@@ -994,7 +1128,7 @@ int gen_pia( dictionary *ini, char **pia_data )
     size = offset = cksum = empty_marker = 0;
     end_marker = 0xc1;
 
-    lang_code = iniparser_getint( ini, get_key( PIA, LANGUAGE_CODE ), -1 );
+    lang_code = fru_config_getint( ini, get_key( PIA, LANGUAGE_CODE ), -1 );
     if( lang_code == -1 )
     {
         fprintf( stdout, "Product language code not specified. "
@@ -1003,10 +1137,10 @@ int gen_pia( dictionary *ini, char **pia_data )
     }
     size += sizeof( struct product_info_area );
 
-    str_data = iniparser_getstring( ini, get_key( PIA, MANUFACTURER ), NULL );
+    str_data = fru_config_getstring( ini, get_key( PIA, MANUFACTURER ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( PIA, MANUFACTURER_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( PIA, MANUFACTURER_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         mfg_size = ( *packerascii )( str_data, key_size, &mfg_packed );
@@ -1018,10 +1152,10 @@ int gen_pia( dictionary *ini, char **pia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( PIA, PRODUCT_NAME ), NULL );
+    str_data = fru_config_getstring( ini, get_key( PIA, PRODUCT_NAME ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( PIA, PRODUCT_NAME_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( PIA, PRODUCT_NAME_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         name_size = ( *packerascii )( str_data, key_size, &name_packed );
@@ -1033,10 +1167,10 @@ int gen_pia( dictionary *ini, char **pia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( PIA, PART_NUMBER ), NULL );
+    str_data = fru_config_getstring( ini, get_key( PIA, PART_NUMBER ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( PIA, PART_NUMBER_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( PIA, PART_NUMBER_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         part_num_size = ( *packerascii )( str_data, key_size, &part_num_packed );
@@ -1048,10 +1182,10 @@ int gen_pia( dictionary *ini, char **pia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( PIA, VERSION ), NULL );
+    str_data = fru_config_getstring( ini, get_key( PIA, VERSION ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( PIA, VERSION_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( PIA, VERSION_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         version_size = ( *packerascii )( str_data, key_size, &version_packed );
@@ -1063,10 +1197,10 @@ int gen_pia( dictionary *ini, char **pia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( PIA, SERIAL_NUMBER ), NULL );
+    str_data = fru_config_getstring( ini, get_key( PIA, SERIAL_NUMBER ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( PIA, SERIAL_NUMBER_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( PIA, SERIAL_NUMBER_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         serial_num_size = ( *packerascii )( str_data, key_size, &serial_num_packed );
@@ -1078,10 +1212,10 @@ int gen_pia( dictionary *ini, char **pia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( PIA, ASSET_TAG ), NULL );
+    str_data = fru_config_getstring( ini, get_key( PIA, ASSET_TAG ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( PIA, ASSET_TAG_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( PIA, ASSET_TAG_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         asset_tag_size = ( *packerascii )( str_data, key_size, &asset_tag_packed );
@@ -1093,10 +1227,10 @@ int gen_pia( dictionary *ini, char **pia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( PIA, FRU_FILE_ID ), NULL );
+    str_data = fru_config_getstring( ini, get_key( PIA, FRU_FILE_ID ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( PIA, FRU_FILE_ID_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( PIA, FRU_FILE_ID_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         fru_file_id_size = ( *packerascii )( str_data, key_size, &fru_file_id_packed );
@@ -1110,10 +1244,10 @@ int gen_pia( dictionary *ini, char **pia_data )
 
     /* We don't handle FRU File ID for now... */
     //size += 1;
-    str_data = iniparser_getstring( ini, get_key( PIA, PRODUCT_FAMILY ), NULL );
+    str_data = fru_config_getstring( ini, get_key( PIA, PRODUCT_FAMILY ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( PIA, FAMILY_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( PIA, FAMILY_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         family_size = ( *packerascii )( str_data, key_size, &family_packed );
@@ -1125,10 +1259,10 @@ int gen_pia( dictionary *ini, char **pia_data )
         size += 1;
     }
 
-    str_data = iniparser_getstring( ini, get_key( PIA, SKU_ID ), NULL );
+    str_data = fru_config_getstring( ini, get_key( PIA, SKU_ID ), NULL );
     if( str_data && strlen( str_data ) )
     {
-        key_size = iniparser_getint( ini, get_key( PIA, SKU_ID_SIZE ), 0 );
+        key_size = fru_config_getint( ini, get_key( PIA, SKU_ID_SIZE ), 0 );
         if( !key_size )
             key_size = ( strlen( str_data ) & 0x3f ) | TYPE_CODE_UNILATIN;
         skuid_size = ( *packerascii )( str_data, key_size, &skuid_packed );
@@ -1141,8 +1275,8 @@ int gen_pia( dictionary *ini, char **pia_data )
     }
 
 
-    num_keys = iniparser_getsecnkeys( ini, PIA );
-    sec_keys = iniparser_getseckeys( ini, PIA );
+    num_keys = fru_config_getsecnkeys( ini, PIA );
+    sec_keys = fru_config_getseckeys( ini, PIA );
 
     /* first iteration calculates the amount of space needed */
     for( i = 0; i < num_keys; i++ )
@@ -1171,7 +1305,7 @@ int gen_pia( dictionary *ini, char **pia_data )
         {
             continue;
         }
-        str_data = iniparser_getstring( ini, key, NULL );
+        str_data = fru_config_getstring( ini, key, NULL );
         if( str_data && strlen( str_data ) )
         {
             size += ( *packer )( str_data, &packed_ascii );
@@ -1319,7 +1453,7 @@ int gen_pia( dictionary *ini, char **pia_data )
         {
             continue;
         }
-        str_data = iniparser_getstring( ini, key, NULL );
+        str_data = fru_config_getstring( ini, key, NULL );
         if( str_data && strlen( str_data ) )
         {
             packed_size = ( *packer )( str_data, &packed_ascii );
@@ -1338,7 +1472,48 @@ int gen_pia( dictionary *ini, char **pia_data )
     return pia->area_length;
 }
 
-int gen_mia_mar( dictionary * ini, char * * mia_data )
+/*
+ * mia_mar record_data is a literal UUID, "random" (or "v4") for a fresh
+ * random one per unit, or "v5" for a name-based one from uuid_namespace
+ * (a UUID or dns/url/oid/x500) and uuid_name. uuid_name defaults to the
+ * board serial number, then the product and chassis ones. Returns the UUID
+ * version to generate, 0 for a literal one, -1 on a bad config.
+ */
+int get_mar_uuid_version( dictionary * ini, uint8_t *ns )
+{
+    char *str_data;
+
+    str_data = fru_config_getstring( ini, get_key( MIA_MAR, RECORD_DATA ), NULL );
+    if( str_data == NULL )
+        return -1;
+    if( !strcmp( str_data, "random" ) || !strcmp( str_data, "v4" ) )
+        return 4;
+    if( strcmp( str_data, "v5" ) )
+        return 0;
+
+    str_data = fru_config_getstring( ini, get_key( MIA_MAR, UUID_NAMESPACE ), NULL );
+    if( str_data == NULL || fru_uuid_namespace( str_data, ns ) )
+    {
+        fprintf( stderr, "\nInvalid UUID namespace\n\n" );
+        return -1;
+    }
+    return 5;
+}
+
+static char *get_mar_uuid_name( dictionary * ini )
+{
+    const char *sections[] = { BIA, PIA, CIA };
+    char *name;
+    int i;
+
+    name = fru_config_getstring( ini, get_key( MIA_MAR, UUID_NAME ), NULL );
+    for( i = 0; !name && i < 3; i++ )
+        name = fru_config_getstring( ini, get_key( sections[i], SERIAL_NUMBER ), NULL );
+
+    return name;
+}
+
+int gen_mia_mar( dictionary * ini, const char *section, char * * mia_data )
 {
     struct management_access_record *mar;
     char *data,
@@ -1347,23 +1522,24 @@ int gen_mia_mar( dictionary * ini, char * * mia_data )
     int record_type_id,
         record_format_version,
         sub_record_type,
+        uuid_version,
         size,
         offset;
 
-    uint8_t headercksum, cksum;
+    uint8_t headercksum, cksum, ns[UUID_BYTE_LENGTH];
 
     mar = NULL;
     size = offset = cksum = headercksum = 0;
 
-    record_type_id        = iniparser_getint( ini, get_key( MIA_MAR, RECORD_TYPE_ID ), 0 );
-    record_format_version = iniparser_getint( ini, get_key( MIA_MAR, RECORD_FORMAT_VERSION ), 0 );
-    sub_record_type       = iniparser_getint( ini, get_key( MIA_MAR, SUB_RECORD_TYPE ), 0 );
+    record_type_id        = fru_config_getint( ini, get_key( section, RECORD_TYPE_ID ), 0 );
+    record_format_version = fru_config_getint( ini, get_key( section, RECORD_FORMAT_VERSION ), 0 );
+    sub_record_type       = fru_config_getint( ini, get_key( section, SUB_RECORD_TYPE ), 0 );
 
-    uuid_str_data = iniparser_getstring( ini, get_key( MIA_MAR, RECORD_DATA ), NULL );
-    if( uuid_str_data == NULL && strlen( uuid_str_data ) != UUID_STR_LENGTH )
+    uuid_version = get_mar_uuid_version( ini, ns );
+    if( uuid_version < 0 )
     {
         fprintf( stderr, "\nInvalid UUID data\n\n" );
-        exit( EXIT_FAILURE );
+        return -1;
     }
 
     // mia_mar struct size
@@ -1371,20 +1547,29 @@ int gen_mia_mar( dictionary * ini, char * * mia_data )
     data = ( char * ) calloc( size, 1 );
     mar = ( struct management_access_record * ) data;
 
-    memset( mar->record_data, 0, UUID_BYTE_LENGTH );
-
-    sscanf( uuid_str_data,
-            "%2hhx%2hhx%2hhx%2hhx-"
-            "%2hhx%2hhx-"
-            "%2hhx%2hhx-"
-            "%2hhx%2hhx-"
-            "%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx",
-            &mar->record_data[0], &mar->record_data[1], &mar->record_data[2], &mar->record_data[3],
-            &mar->record_data[4], &mar->record_data[5],
-            &mar->record_data[6], &mar->record_data[7],
-            &mar->record_data[8], &mar->record_data[9],
-            &mar->record_data[10], &mar->record_data[11], &mar->record_data[12], &mar->record_data[13],
-            &mar->record_data[14], &mar->record_data[15] );
+    if( uuid_version == 4 )
+        fru_uuid_v4( mar->record_data );
+    else if( uuid_version == 5 )
+    {
+        uuid_str_data = get_mar_uuid_name( ini );
+        if( uuid_str_data == NULL )
+        {
+            fprintf( stderr, "\nNo uuid_name or serial number for a v5 UUID\n\n" );
+            free( data );
+            return -1;
+        }
+        fru_uuid_v5( ns, uuid_str_data, strlen( uuid_str_data ), mar->record_data );
+    }
+    else
+    {
+        uuid_str_data = fru_config_getstring( ini, get_key( section, RECORD_DATA ), NULL );
+        if( fru_uuid_parse( uuid_str_data, mar->record_data ) )
+        {
+            fprintf( stderr, "\nInvalid UUID data\n\n" );
+            free( data );
+            return -1;
+        }
+    }
 
     /* Fill up MAR */
     mar->record_header.type_id = record_type_id;
@@ -1405,7 +1590,7 @@ int gen_mia_mar( dictionary * ini, char * * mia_data )
     return size;
 }
 
-int gen_mia_ver( dictionary * ini, char * * mia_data )
+int gen_mia_ver( dictionary * ini, const char *section, char * * mia_data )
 {
     struct oem_vpd_version *oem_ver;
     char *data;
@@ -1422,10 +1607,10 @@ int gen_mia_ver( dictionary * ini, char * * mia_data )
     oem_ver = NULL;
     size = offset = cksum = headercksum = 0;
 
-    record_type_id        = iniparser_getint( ini, get_key( MIA_VER, RECORD_TYPE_ID ), 0 );
-    record_format_version = iniparser_getint( ini, get_key( MIA_VER, RECORD_FORMAT_VERSION ), 0 );
-    major_version         = iniparser_getint( ini, get_key( MIA_VER, OEM_MAJOR_VER ), 0 );
-    minor_version         = iniparser_getint( ini, get_key( MIA_VER, OEM_MINOR_VER ), 0 );
+    record_type_id        = fru_config_getint( ini, get_key( section, RECORD_TYPE_ID ), 0 );
+    record_format_version = fru_config_getint( ini, get_key( section, RECORD_FORMAT_VERSION ), 0 );
+    major_version         = fru_config_getint( ini, get_key( section, OEM_MAJOR_VER ), 0 );
+    minor_version         = fru_config_getint( ini, get_key( section, OEM_MINOR_VER ), 0 );
 
     size += sizeof( struct oem_vpd_version );
     data = ( char * ) calloc( size, 1 );
@@ -1451,7 +1636,7 @@ int gen_mia_ver( dictionary * ini, char * * mia_data )
     return size;
 }
 
-int gen_mia_mac( dictionary * ini, char * * mia_data )
+int gen_mia_mac( dictionary * ini, const char *section, char * * mia_data )
 {
     struct mac_address *mac;
     char *data,
@@ -1472,32 +1657,11 @@ int gen_mia_mac( dictionary * ini, char * * mia_data )
     mac = NULL;
     size = offset = cksum = headercksum = 0;
 
-    record_type_id        = iniparser_getint( ini, get_key( MIA_MAC, RECORD_TYPE_ID ), 0 );
-    record_format_version = iniparser_getint( ini, get_key( MIA_MAC, RECORD_FORMAT_VERSION ), 0 );
-    host_mac_count        = iniparser_getint( ini, get_key( MIA_MAC, HOST_MAC_COUNT ), 0 );
-    bmc_mac_count         = iniparser_getint( ini, get_key( MIA_MAC, BMC_MAC_COUNT ), 0 );
-    switch_mac_count      = iniparser_getint( ini, get_key( MIA_MAC, SWITCH_MAC_COUNT ), 0 );
-
-    host_base_address = iniparser_getstring( ini, get_key( MIA_MAC, HOST_BASE_MAC ), NULL );
-    if( host_base_address == NULL || strlen( host_base_address ) != MAC_ADDRESS_STR_LENGTH )
-    {
-        fprintf( stderr, "\nInvalid Host Base MAC Address\n\n" );
-        exit( EXIT_FAILURE );
-    }
-
-    bmc_base_address = iniparser_getstring( ini, get_key( MIA_MAC, BMC_BASE_MAC ), NULL );
-    if( bmc_base_address == NULL || strlen( bmc_base_address ) != MAC_ADDRESS_STR_LENGTH )
-    {
-        fprintf( stderr, "\nInvalid BMC Base MAC Address\n\n" );
-        exit( EXIT_FAILURE );
-    }
-
-    switch_base_address = iniparser_getstring( ini, get_key( MIA_MAC, SWITCH_BASE_MAC ), NULL );
-    if( switch_base_address == NULL || strlen( switch_base_address ) != MAC_ADDRESS_STR_LENGTH )
-    {
-        fprintf( stderr, "\nInvalid Switch Base MAC Address\n\n" );
-        exit( EXIT_FAILURE );
-    }
+    record_type_id        = fru_config_getint( ini, get_key( section, RECORD_TYPE_ID ), 0 );
+    record_format_version = fru_config_getint( ini, get_key( section, RECORD_FORMAT_VERSION ), 0 );
+    host_mac_count        = fru_config_getint( ini, get_key( section, HOST_MAC_COUNT ), 0 );
+    bmc_mac_count         = fru_config_getint( ini, get_key( section, BMC_MAC_COUNT ), 0 );
+    switch_mac_count      = fru_config_getint( ini, get_key( section, SWITCH_MAC_COUNT ), 0 );
 
     size += sizeof( struct mac_address );
     data = ( char * ) calloc( size, 1 );
@@ -1510,23 +1674,59 @@ int gen_mia_mac( dictionary * ini, char * * mia_data )
     mac->record_header.record_length = size - sizeof( struct multi_record_header );
 
     mac->host_mac_address_count = host_mac_count;
-    sscanf( host_base_address, "%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx",
-            &mac->host_base_mac_address[0], &mac->host_base_mac_address[1],
-            &mac->host_base_mac_address[2], &mac->host_base_mac_address[3],
-            &mac->host_base_mac_address[4], &mac->host_base_mac_address[5] );
-
     mac->bmc_mac_address_count = bmc_mac_count;
-    sscanf( bmc_base_address, "%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx",
-            &mac->bmc_base_mac_address[0], &mac->bmc_base_mac_address[1],
-            &mac->bmc_base_mac_address[2], &mac->bmc_base_mac_address[3],
-            &mac->bmc_base_mac_address[4], &mac->bmc_base_mac_address[5] );
-
     mac->switch_mac_address_count = switch_mac_count;
-    sscanf( switch_base_address, "%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx",
-            &mac->switch_base_mac_address[0], &mac->switch_base_mac_address[1],
-            &mac->switch_base_mac_address[2], &mac->switch_base_mac_address[3],
-            &mac->switch_base_mac_address[4], &mac->switch_base_mac_address[5] );
 
+    /* With a MAC pool the base addresses are allocated, not configured */
+    if( mac_pool )
+    {
+        if( mac_pool_assign( mac_pool, mac_pool->chunk ? &mac_pool->local : NULL, mac ) )
+        {
+            free( data );
+            return -1;
+        }
+    }
+    else
+    {
+        host_base_address = fru_config_getstring( ini, get_key( section, HOST_BASE_MAC ), NULL );
+        if( host_base_address == NULL || strlen( host_base_address ) != MAC_ADDRESS_STR_LENGTH )
+        {
+            fprintf( stderr, "\nInvalid Host Base MAC Address\n\n" );
+            free( data );
+            return -1;
+        }
+
+        bmc_base_address = fru_config_getstring( ini, get_key( section, BMC_BASE_MAC ), NULL );
+        if( bmc_base_address == NULL || strlen( bmc_base_address ) != MAC_ADDRESS_STR_LENGTH )
+        {
+            fprintf( stderr, "\nInvalid BMC Base MAC Address\n\n" );
+            free( data );
+            return -1;
+        }
+
+        switch_base_address = fru_config_getstring( ini, get_key( section, SWITCH_BASE_MAC ), NULL );
+        if( switch_base_address == NULL || strlen( switch_base_address ) != MAC_ADDRESS_STR_LENGTH )
+        {
+            fprintf( stderr, "\nInvalid Switch Base MAC Address\n\n" );
+            free( data );
+            return -1;
+        }
+
+        sscanf( host_base_address, "%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx",
+                &mac->host_base_mac_address[0], &mac->host_base_mac_address[1],
+                &mac->host_base_mac_address[2], &mac->host_base_mac_address[3],
+                &mac->host_base_mac_address[4], &mac->host_base_mac_address[5] );
+
+        sscanf( bmc_base_address, "%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx",
+                &mac->bmc_base_mac_address[0], &mac->bmc_base_mac_address[1],
+                &mac->bmc_base_mac_address[2], &mac->bmc_base_mac_address[3],
+                &mac->bmc_base_mac_address[4], &mac->bmc_base_mac_address[5] );
+
+        sscanf( switch_base_address, "%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx",
+                &mac->switch_base_mac_address[0], &mac->switch_base_mac_address[1],
+                &mac->switch_base_mac_address[2], &mac->switch_base_mac_address[3],
+                &mac->switch_base_mac_address[4], &mac->switch_base_mac_address[5] );
+    }
 
     offset = sizeof( struct multi_record_header );
     cksum = get_zero_cksum( ( uint8_t * ) data + offset, mac->record_header.record_length );
@@ -1540,7 +1740,7 @@ int gen_mia_mac( dictionary * ini, char * * mia_data )
     return size;
 }
 
-int gen_mia_fan( dictionary * ini, char * * mia_data )
+int gen_mia_fan( dictionary * ini, const char *section, char * * mia_data )
 {
     struct fan_speed_control_parameter *fan;
     char *data;
@@ -1557,10 +1757,10 @@ int gen_mia_fan( dictionary * ini, char * * mia_data )
     fan = NULL;
     size = offset = cksum = headercksum = 0;
 
-    record_type_id        = iniparser_getint( ini, get_key( MIA_FAN, RECORD_TYPE_ID ), 0 );
-    record_format_version = iniparser_getint( ini, get_key( MIA_FAN, RECORD_FORMAT_VERSION ), 0 );
-    fan_speed             = iniparser_getint( ini, get_key( MIA_FAN, MAX_FAN_SPEED ), 0 );
-    fan_airflow           = iniparser_getint( ini, get_key( MIA_FAN, FAN_AIRFLOW ), 0 );
+    record_type_id        = fru_config_getint( ini, get_key( section, RECORD_TYPE_ID ), 0 );
+    record_format_version = fru_config_getint( ini, get_key( section, RECORD_FORMAT_VERSION ), 0 );
+    fan_speed             = fru_config_getint( ini, get_key( section, MAX_FAN_SPEED ), 0 );
+    fan_airflow           = fru_config_getint( ini, get_key( section, FAN_AIRFLOW ), 0 );
 
     size += sizeof( struct fan_speed_control_parameter );
     data = ( char * ) calloc( size, 1 );
@@ -1587,7 +1787,7 @@ int gen_mia_fan( dictionary * ini, char * * mia_data )
     return size;
 }
 
-int gen_mia_bci( dictionary * ini, char * * mia_data )
+int gen_mia_bci( dictionary * ini, const char *section, char * * mia_data )
 {
     struct board_controller_info *bci;
     char *data,
@@ -1605,28 +1805,28 @@ int gen_mia_bci( dictionary * ini, char * * mia_data )
     bci = NULL;
     size = offset = cksum = headercksum = 0;
 
-    record_type_id        = iniparser_getint( ini, get_key( MIA_BCI, RECORD_TYPE_ID ), 0 );
-    record_format_version = iniparser_getint( ini, get_key( MIA_BCI, RECORD_FORMAT_VERSION ), 0 );
+    record_type_id        = fru_config_getint( ini, get_key( section, RECORD_TYPE_ID ), 0 );
+    record_format_version = fru_config_getint( ini, get_key( section, RECORD_FORMAT_VERSION ), 0 );
 
-    packed_vendor_id = iniparser_getstring( ini, get_key( MIA_BCI, VENDOR_ID ), NULL );
+    packed_vendor_id = fru_config_getstring( ini, get_key( section, VENDOR_ID ), NULL );
     if( packed_vendor_id == NULL || strlen( packed_vendor_id ) > CPU_VENDOR_ID_STR_LENGTH )
     {
         fprintf( stderr, "\nInvalid CPU type ID\n\n" );
-        exit( EXIT_FAILURE );
+        return -1;
     }
 
-    packed_family = iniparser_getstring( ini, get_key( MIA_BCI, FAMILY ), NULL );
+    packed_family = fru_config_getstring( ini, get_key( section, FAMILY ), NULL );
     if( packed_family == NULL || strlen( packed_family ) > CPU_FAMILY_STR_LENGTH )
     {
         fprintf( stderr, "\nInvalid CPU type ID\n\n" );
-        exit( EXIT_FAILURE );
+        return -1;
     }
 
-    packed_type = iniparser_getstring( ini, get_key( MIA_BCI, CONTROLLER_TYPE ), NULL );
+    packed_type = fru_config_getstring( ini, get_key( section, CONTROLLER_TYPE ), NULL );
     if( packed_type == NULL || strlen( packed_type ) > CPU_TYPE_STR_LENGTH )
     {
         fprintf( stderr, "\nInvalid CPU type ID\n\n" );
-        exit( EXIT_FAILURE );
+        return -1;
     }
 
     size += sizeof( struct board_controller_info );
@@ -1640,11 +1840,11 @@ int gen_mia_bci( dictionary * ini, char * * mia_data )
     bci->record_header.record_length = size - sizeof( struct multi_record_header );
 
     memset( bci->vendor_id, 0, CPU_VENDOR_ID_STR_LENGTH );
-    memcpy( bci->vendor_id, packed_vendor_id, CPU_VENDOR_ID_STR_LENGTH );
+    memcpy( bci->vendor_id, packed_vendor_id, strlen( packed_vendor_id ) );
     memset( bci->family, 0, CPU_FAMILY_STR_LENGTH );
-    memcpy( bci->family, packed_family, CPU_FAMILY_STR_LENGTH );
+    memcpy( bci->family, packed_family, strlen( packed_family ) );
     memset( bci->type, 0, CPU_TYPE_STR_LENGTH );
-    memcpy( bci->type, packed_type, CPU_TYPE_STR_LENGTH );
+    memcpy( bci->type, packed_type, strlen( packed_type ) );
 
     offset = sizeof( struct multi_record_header );
     cksum = get_zero_cksum( ( uint8_t * ) data + offset, bci->record_header.record_length );
@@ -1658,7 +1858,7 @@ int gen_mia_bci( dictionary * ini, char * * mia_data )
     return size;
 }
 
-int gen_mia_sysc( dictionary * ini, char * * mia_data )
+int gen_mia_sysc( dictionary * ini, const char *section, char * * mia_data )
 {
     struct system_configuration *sysc;
     char *data;
@@ -1674,9 +1874,9 @@ int gen_mia_sysc( dictionary * ini, char * * mia_data )
     sysc = NULL;
     size = offset = cksum = headercksum = 0;
 
-    record_type_id        = iniparser_getint( ini, get_key( MIA_SC, RECORD_TYPE_ID ), 0 );
-    record_format_version = iniparser_getint( ini, get_key( MIA_SC, RECORD_FORMAT_VERSION ), 0 );
-    customer_id           = iniparser_getint( ini, get_key( MIA_SC, CUSTOMER_ID ), 0 );
+    record_type_id        = fru_config_getint( ini, get_key( section, RECORD_TYPE_ID ), 0 );
+    record_format_version = fru_config_getint( ini, get_key( section, RECORD_FORMAT_VERSION ), 0 );
+    customer_id           = fru_config_getint( ini, get_key( section, CUSTOMER_ID ), 0 );
 
     size += sizeof( struct system_configuration );
     data = ( char * ) calloc( size, 1 );
@@ -1701,235 +1901,691 @@ int gen_mia_sysc( dictionary * ini, char * * mia_data )
     return size;
 }
 
-int gen_fru_data( dictionary *ini, char **raw_data )
+/* Hex payload, bytes optionally separated by spaces, ':' or '-' */
+static int parse_hex_payload( const char *str, uint8_t *out, int max )
 {
-    int total_length,
-        offset,
-        mia_mar_offset,
-        mia_ver_offset,
-        mia_mac_offset,
-        mia_fan_offset,
-        mia_bci_offset,
-        mia_sysc_offset,
-        mia_mar_len_mul8,
-        mia_ver_len_mul8,
-        mia_mac_len_mul8,
-        mia_fan_len_mul8,
-        mia_bci_len_mul8,
-        mia_sysc_len_mul8,
-        len_mul8,
-        iua_len,
-        size,
-        cksum;
+    int length, hi, lo;
 
-    char *iua, *cia, *bia, *pia, *mia_mar, *mia_ver, *mia_mac, *mia_fan, *mia_bci, *mia_sysc, *data;
+    length = 0;
+    while( *str )
+    {
+        if( *str == ' ' || *str == ':' || *str == '-' )
+        {
+            str++;
+            continue;
+        }
+        if( !isxdigit( ( unsigned char ) str[0] ) || !isxdigit( ( unsigned char ) str[1] ) ||
+            length == max )
+            return -1;
+        hi = isdigit( ( unsigned char ) str[0] ) ? str[0] - '0' : tolower( str[0] ) - 'a' + 10;
+        lo = isdigit( ( unsigned char ) str[1] ) ? str[1] - '0' : tolower( str[1] ) - 'a' + 10;
+        out[length++] = ( hi << 4 ) | lo;
+        str += 2;
+    }
+    return length;
+}
 
-    iua = cia = bia = pia = data = NULL;
-    total_length = offset = len_mul8 = iua_len = size = cksum = 0;
-    mia_mar_offset = mia_ver_offset = mia_mac_offset = mia_fan_offset = mia_bci_offset = mia_sysc_offset = 0;
-    mia_mar_len_mul8 = mia_ver_len_mul8 = mia_mac_len_mul8 = mia_fan_len_mul8 = mia_bci_len_mul8 = mia_sysc_len_mul8 = 0;
+/* Arbitrary record: type_id plus a hex record_data payload */
+int gen_mia_oem( dictionary * ini, const char *section, char * * mia_data )
+{
+    struct multirecord_int_record *rec;
+    char *data,
+         *str_data;
 
-    /* A common header always exists even if there's no FRU data */
-    struct fru_common_header *fch =
-        ( struct fru_common_header * ) calloc( sizeof( struct fru_common_header ),
-                1 );
-    fch->format_version = 0x01;
-    total_length += sizeof( struct fru_common_header );
-    offset = total_length / 8;
+    int record_type_id,
+        record_format_version,
+        length;
 
-    /* Parse "Internal Use Area" (IUA) section */
-    if( iniparser_find_entry( ini, IUA ) )
-    {
-        iua_len = gen_iua( ini, &iua );
-        fch->internal_use_offset = offset;
+    uint8_t payload[255];
 
-        offset += ( iua_len / 8 );
-        total_length += iua_len;
+    record_type_id        = fru_config_getint( ini, get_key( section, RECORD_TYPE_ID ), -1 );
+    record_format_version = fru_config_getint( ini, get_key( section, RECORD_FORMAT_VERSION ), 2 );
+    if( record_type_id < 0 || record_type_id > 0xff )
+    {
+        fprintf( stderr, "\nMissing or invalid type_id in [%s]\n\n", section );
+        return -1;
     }
 
-    /* Parse "Chassis Info Area" (CIA) section */
-    if( iniparser_find_entry( ini, CIA ) )
+    str_data = fru_config_getstring( ini, get_key( section, RECORD_DATA ), "" );
+    length = parse_hex_payload( str_data, payload, sizeof( payload ) );
+    if( length < 0 )
     {
-        len_mul8 = gen_cia( ini, &cia );
-        fch->chassis_info_offset = offset;
-
-        offset += len_mul8;
-        total_length += len_mul8 * 8;
+        fprintf( stderr, "\nInvalid record_data in [%s]: up to 255 hex bytes expected\n\n",
+                 section );
+        return -1;
     }
 
-    /* Parse "Board Info Area" (BIA) section */
-    if( iniparser_find_entry( ini, BIA ) )
-    {
-        len_mul8 = gen_bia( ini, &bia );
-        fch->board_info_offset = offset;
+    data = ( char * ) calloc( sizeof( struct multi_record_header ) + length, 1 );
+    rec = ( struct multirecord_int_record * ) data;
+    rec->record_header.type_id = record_type_id;
+    rec->record_header.format_version = record_format_version;
+    rec->record_header.record_length = length;
+    memcpy( rec->record_data, payload, length );
 
-        offset += len_mul8;
-        total_length += len_mul8 * 8;
-    }
+    /* Checksums are filled in by seal_records() */
+    *mia_data = data;
 
-    /* Parse "Product Info Area" (PIA) section */
-    if( iniparser_find_entry( ini, PIA ) )
-    {
-        len_mul8 = gen_pia( ini, &pia );
-        fch->product_info_offset = offset;
+    return sizeof( struct multi_record_header ) + length;
+}
 
-        offset += len_mul8;
-        total_length += len_mul8 * 8;
-    }
+/* Set by get_record_int(), the record generators check it once all fields are read */
+static __thread int record_invalid;
 
-    /* The offset changes to actual offset from this line. */
+/* Integer key of a record section, checked against the width of its field */
+static int get_record_int( dictionary *ini, const char *section, const char *key,
+                           int def, int min, int max )
+{
+    int value;
 
-    /* Parse "MultiRecord Info Area" (MIA_MAR) section */
-    if( iniparser_find_entry( ini, MIA_MAR ) )
+    value = fru_config_getint( ini, get_key( section, key ), def );
+    if( value < min || value > max )
     {
-        mia_mar_len_mul8 = len_mul8 = gen_mia_mar( ini, &mia_mar );
-        fch->multirecord_info_offset = offset;
-        offset *= 8; // actual offset
-        mia_mar_offset = offset;
+        fprintf( stderr, "\nInvalid %s in [%s]: %d is outside %d..%d\n\n",
+                 key, section, value, min, max );
+        record_invalid = 1;
+    }
+    return value;
+}
 
-        offset += len_mul8;
-        total_length += len_mul8;
+/* The power supply records have a fixed layout: encoding is one store per field */
+int gen_mia_psu( dictionary * ini, const char *section, char * * mia_data )
+{
+    struct power_supply_information *psu;
+    int size;
+
+    size = sizeof( struct power_supply_information );
+    psu = ( struct power_supply_information * ) calloc( size, 1 );
+    record_invalid = 0;
+
+    psu->record_header.type_id = fru_config_getint( ini, get_key( section, RECORD_TYPE_ID ), MULTI_RECORD_ID_PSU );
+    psu->record_header.format_version = fru_config_getint( ini, get_key( section, RECORD_FORMAT_VERSION ), 2 );
+    psu->record_header.record_length = size - sizeof( struct multi_record_header );
+
+    psu->overall_capacity     = get_record_int( ini, section, OVERALL_CAPACITY, 0, 0, 0xfff );
+    psu->peak_va              = get_record_int( ini, section, PEAK_VA, 0xffff, 0, 0xffff );
+    psu->inrush_current       = get_record_int( ini, section, INRUSH_CURRENT, 0xff, 0, 0xff );
+    psu->inrush_interval      = get_record_int( ini, section, INRUSH_INTERVAL, 0, 0, 0xff );
+    psu->low_input_voltage_1  = get_record_int( ini, section, LOW_INPUT_VOLTAGE_1, 0, 0, 0xffff );
+    psu->high_input_voltage_1 = get_record_int( ini, section, HIGH_INPUT_VOLTAGE_1, 0, 0, 0xffff );
+    psu->low_input_voltage_2  = get_record_int( ini, section, LOW_INPUT_VOLTAGE_2, 0, 0, 0xffff );
+    psu->high_input_voltage_2 = get_record_int( ini, section, HIGH_INPUT_VOLTAGE_2, 0, 0, 0xffff );
+    psu->low_input_frequency  = get_record_int( ini, section, LOW_INPUT_FREQUENCY, 0, 0, 0xff );
+    psu->high_input_frequency = get_record_int( ini, section, HIGH_INPUT_FREQUENCY, 0, 0, 0xff );
+    psu->ac_dropout_tolerance = get_record_int( ini, section, AC_DROPOUT_TOLERANCE, 0, 0, 0xff );
+
+    psu->flags = ( get_record_int( ini, section, PREDICTIVE_FAIL_PIN, 0, 0, 1 ) ? PSU_FLAG_PREDICTIVE_FAIL_PIN : 0 ) |
+                 ( get_record_int( ini, section, POWER_FACTOR_CORRECTION, 0, 0, 1 ) ? PSU_FLAG_POWER_FACTOR_CORRECTION : 0 ) |
+                 ( get_record_int( ini, section, AUTOSWITCH, 0, 0, 1 ) ? PSU_FLAG_AUTOSWITCH : 0 ) |
+                 ( get_record_int( ini, section, HOT_SWAP, 0, 0, 1 ) ? PSU_FLAG_HOT_SWAP : 0 ) |
+                 ( get_record_int( ini, section, PREDICTIVE_FAIL_TACH, 0, 0, 1 ) ? PSU_FLAG_PREDICTIVE_FAIL_TACH : 0 );
+
+    psu->peak_wattage = get_record_int( ini, section, HOLD_UP_TIME, 0, 0, 0xf ) << 12 |
+                        get_record_int( ini, section, PEAK_CAPACITY, 0, 0, 0xfff );
+    psu->combined_voltages = get_record_int( ini, section, COMBINED_VOLTAGE_1, 0, 0, 0xf ) << 4 |
+                             get_record_int( ini, section, COMBINED_VOLTAGE_2, 0, 0, 0xf );
+    psu->combined_wattage     = get_record_int( ini, section, COMBINED_WATTAGE, 0, 0, 0xffff );
+    psu->tach_lower_threshold = get_record_int( ini, section, TACH_LOWER_THRESHOLD, 0, 0, 0xff );
+
+    if( record_invalid )
+    {
+        free( psu );
+        return -1;
     }
 
-    /* Parse "MultiRecord Info Area" (MIA_VER) section */
-    if( iniparser_find_entry( ini, MIA_VER ) )
-    {
-        mia_ver_len_mul8 = len_mul8 = gen_mia_ver( ini, &mia_ver );
-        mia_ver_offset = offset;
+    /* Checksums are filled in by seal_records() */
+    *mia_data = ( char * ) psu;
 
-        offset += len_mul8;
-        total_length += len_mul8;
-    }
+    return size;
+}
 
-    /* Parse "MultiRecord Info Area" (MIA_MAC) section */
-    if( iniparser_find_entry( ini, MIA_MAC ) )
-    {
-        mia_mac_len_mul8 = len_mul8 = gen_mia_mac( ini, &mia_mac );
-        mia_mac_offset = offset;
+int gen_mia_dc_output( dictionary * ini, const char *section, char * * mia_data )
+{
+    struct dc_output *out;
+    int size;
+
+    size = sizeof( struct dc_output );
+    out = ( struct dc_output * ) calloc( size, 1 );
+    record_invalid = 0;
+
+    out->record_header.type_id = fru_config_getint( ini, get_key( section, RECORD_TYPE_ID ), MULTI_RECORD_ID_DC_OUTPUT );
+    out->record_header.format_version = fru_config_getint( ini, get_key( section, RECORD_FORMAT_VERSION ), 2 );
+    out->record_header.record_length = size - sizeof( struct multi_record_header );
 
-        offset += len_mul8;
-        total_length += len_mul8;
+    out->output_information     = get_record_int( ini, section, STANDBY, 0, 0, 1 ) << 7 |
+                                  get_record_int( ini, section, OUTPUT_NUMBER, 0, 0, 0xf );
+    out->nominal_voltage        = get_record_int( ini, section, NOMINAL_VOLTAGE, 0, -32768, 32767 );
+    out->max_negative_deviation = get_record_int( ini, section, MAX_NEGATIVE_DEVIATION, 0, -32768, 32767 );
+    out->max_positive_deviation = get_record_int( ini, section, MAX_POSITIVE_DEVIATION, 0, -32768, 32767 );
+    out->ripple_noise           = get_record_int( ini, section, RIPPLE_NOISE, 0, 0, 0xffff );
+    out->min_current            = get_record_int( ini, section, MIN_CURRENT, 0, 0, 0xffff );
+    out->max_current            = get_record_int( ini, section, MAX_CURRENT, 0, 0, 0xffff );
+
+    if( record_invalid )
+    {
+        free( out );
+        return -1;
     }
+    *mia_data = ( char * ) out;
 
-    /* Parse "MultiRecord Info Area" (MIA_FAN) section */
-    if( iniparser_find_entry( ini, MIA_FAN ) )
+    return size;
+}
+
+int gen_mia_dc_load( dictionary * ini, const char *section, char * * mia_data )
+{
+    struct dc_load *load;
+    int size;
+
+    size = sizeof( struct dc_load );
+    load = ( struct dc_load * ) calloc( size, 1 );
+    record_invalid = 0;
+
+    load->record_header.type_id = fru_config_getint( ini, get_key( section, RECORD_TYPE_ID ), MULTI_RECORD_ID_DC_LOAD );
+    load->record_header.format_version = fru_config_getint( ini, get_key( section, RECORD_FORMAT_VERSION ), 2 );
+    load->record_header.record_length = size - sizeof( struct multi_record_header );
+
+    load->output_number   = get_record_int( ini, section, OUTPUT_NUMBER, 0, 0, 0xf );
+    load->nominal_voltage = get_record_int( ini, section, NOMINAL_VOLTAGE, 0, -32768, 32767 );
+    load->min_voltage     = get_record_int( ini, section, MIN_VOLTAGE, 0, -32768, 32767 );
+    load->max_voltage     = get_record_int( ini, section, MAX_VOLTAGE, 0, -32768, 32767 );
+    load->ripple_noise    = get_record_int( ini, section, RIPPLE_NOISE, 0, 0, 0xffff );
+    load->min_current     = get_record_int( ini, section, MIN_CURRENT, 0, 0, 0xffff );
+    load->max_current     = get_record_int( ini, section, MAX_CURRENT, 0, 0, 0xffff );
+
+    if( record_invalid )
     {
-        mia_fan_len_mul8 = len_mul8 = gen_mia_fan( ini, &mia_fan );
-        mia_fan_offset += offset;
+        free( load );
+        return -1;
+    }
+    *mia_data = ( char * ) load;
+
+    return size;
+}
 
-        offset += len_mul8;
-        total_length += len_mul8;
+/*
+ * MultiRecord encoders. A record is emitted for every config section named
+ * after an entry, in config order; entries allowing instances also match
+ * "<section>N" and "<section>_NAME" sections. The type id is the default
+ * for sections without a type_id key.
+ */
+struct mia_record_type
+{
+    int         type_id;
+    const char  *section;
+    int         instances;
+    int         hot;        /* per-unit data, see FRU_LAYOUT_HOT_COLD */
+    int         ( *gen )( dictionary *, const char *, char ** );
+};
+
+static const struct mia_record_type mia_record_types[] =
+{
+    { MULTI_RECORD_ID_PSU, "mia_psu", 1, 0, gen_mia_psu },
+    { MULTI_RECORD_ID_DC_OUTPUT, "mia_dc_output", 1, 0, gen_mia_dc_output },
+    { MULTI_RECORD_ID_DC_LOAD, "mia_dc_load", 1, 0, gen_mia_dc_load },
+    { MULTI_RECORD_ID_MAR, "mia_mar", 0, 1, gen_mia_mar },
+    { MULTI_RECORD_ID_VER, "mia_ver", 1, 0, gen_mia_ver },
+    { MULTI_RECORD_ID_MAC, "mia_mac", 1, 1, gen_mia_mac },
+    { MULTI_RECORD_ID_FAN, "mia_fan", 1, 0, gen_mia_fan },
+    { MULTI_RECORD_ID_BCI, "mia_bci", 1, 0, gen_mia_bci },
+    { MULTI_RECORD_ID_SC,  "mia_sc",  1, 0, gen_mia_sysc },
+    { -1,                  "mia_oem", 1, 0, gen_mia_oem },
+    { 0, NULL, 0, 0, NULL }
+};
+
+static const struct mia_record_type *mia_record_type( const char *section )
+{
+    const struct mia_record_type *type;
+    int length;
+
+    for( type = mia_record_types; type->section; type++ )
+    {
+        length = strlen( type->section );
+        if( strncmp( section, type->section, length ) )
+            continue;
+        if( !section[length] )
+            return type;
+        if( type->instances && ( section[length] == '_' || isdigit( ( unsigned char ) section[length] ) ) )
+            return type;
     }
+    return NULL;
+}
+
+/*
+ * Final pass over the concatenated records: only the last one carries the
+ * end-of-list bit, every checksum is recomputed, and the area is padded to
+ * a multiple of 8 so whatever follows it stays addressable.
+ */
+static void seal_records( struct fru_area_blob *mia )
+{
+    struct multi_record_header *h;
+    int offset, next, padded;
 
-    /* Parse "MultiRecord Info Area" (MIA_BCI) section */
-    if( iniparser_find_entry( ini, MIA_BCI ) )
+    for( offset = 0; offset < mia->length; offset = next )
     {
-        mia_bci_len_mul8 = len_mul8 = gen_mia_bci( ini, &mia_bci );
-        mia_bci_offset = offset;
+        h = ( struct multi_record_header * ) ( mia->data + offset );
+        next = offset + sizeof( *h ) + h->record_length;
 
-        offset += len_mul8;
-        total_length += len_mul8;
+        if( next >= mia->length )
+            h->format_version |= MULTI_RECORD_EOL;
+        else
+            h->format_version &= ~MULTI_RECORD_EOL;
+        h->record_checksum = get_zero_cksum( ( uint8_t * ) h + sizeof( *h ), h->record_length );
+        h->header_checksum = get_zero_cksum( ( uint8_t * ) h, sizeof( *h ) - 1 );
     }
 
-    /* Parse "MultiRecord Info Area" (MIA_SC) section */
-    if( iniparser_find_entry( ini, MIA_SC ) )
+    padded = ( mia->length + 7 ) & ~7;
+    if( padded != mia->length )
     {
-        mia_sysc_len_mul8 = len_mul8 = gen_mia_sysc( ini, &mia_sysc );
-        mia_sysc_offset = offset;
-
-        offset += len_mul8;
-        total_length += len_mul8;
+        mia->data = ( char * ) realloc( mia->data, padded );
+        memset( mia->data + mia->length, 0, padded - mia->length );
+        mia->length = padded;
     }
+}
 
-    /* calculate header checksum */
-    cksum = get_zero_cksum( ( uint8_t * ) fch, sizeof( *fch ) - 1 );
-    fch->checksum = cksum;
+/* Volatile (per-unit) keys, used to classify areas for FRU_LAYOUT_HOT_COLD */
+static int is_hot_section( dictionary *ini, const char *section )
+{
+    char *str_data;
 
-    //    fprintf( stderr, "\ngen_fru_data get size: %d\n", total_length );
-    data = ( char * ) malloc( total_length );
+    /* The manufacturing date is stamped per unit */
+    if( section == BIA )
+        return 1;
+    if( section == MIA_MAR || section == MIA_MAC )
+        return 1;
 
-    /* Copy common header first */
-    memcpy( data, fch, sizeof( struct fru_common_header ) );
+    str_data = fru_config_getstring( ini, get_key( section, SERIAL_NUMBER ), NULL );
+    if( str_data && strlen( str_data ) )
+        return 1;
+    str_data = fru_config_getstring( ini, get_key( section, ASSET_TAG ), NULL );
+    if( str_data && strlen( str_data ) )
+        return 1;
 
-    /* Copy each section's data if any */
-    if( iua )
-    {
-        offset = fch->internal_use_offset * 8;
-        size = *( iua + 1 ) * 8;
-        memcpy( data + offset, iua, size );
+    return 0;
+}
+
+/* Append one encoded record to the MultiRecord area blob */
+static void append_record( struct fru_area_blob *mia, char *record, int size )
+{
+    mia->data = ( char * ) realloc( mia->data, mia->length + size );
+    memcpy( mia->data + mia->length, record, size );
+    mia->length += size;
+}
+
+/*
+ * Hash of everything the encoder of a section reads, 0 when its output
+ * changes from run to run and must never be reused
+ */
+static uint64_t input_hash( dictionary *ini, const char *section )
+{
+    const struct mia_record_type *type;
+    const char *serial_sections[] = { BIA, PIA, CIA };
+    uint8_t ns[UUID_BYTE_LENGTH];
+    char settings[32];
+    uint64_t hash;
+    int i;
+
+    if( section == BIA && !fru_config_find_entry( ini, get_key( BIA, MFG_DATETIME ) ) )
+        return 0;
+    type = mia_record_type( section );
+    if( type && type->type_id == MULTI_RECORD_ID_MAC && mac_pool )
+        return 0;
+
+    snprintf( settings, sizeof( settings ), "%d:%d:%d", packerascii != NULL,
+              layout_policy.mode, layout_policy.reserve );
+    hash = fru_regen_hash( 0, settings );
+    hash = fru_regen_hash_section( ini, section, hash );
+
+    /* The IUA blob is an input too: a rewritten file has a new mtime */
+    if( section == IUA )
+    {
+        char *bin_file = fru_config_getstring( ini, get_key( IUA, BINFILE ), NULL );
+        struct stat *st = &bin_file_stat;
+        char stamp[96];
+
+        if( bin_file && strlen( bin_file ) )
+        {
+            if( stat( bin_file, st ) )
+                return 0;
+            bin_file_stat_valid = 1;
+            snprintf( stamp, sizeof( stamp ), "%llu:%lld:%lld.%ld",
+                      ( unsigned long long ) st->st_ino, ( long long ) st->st_size,
+                      ( long long ) st->st_mtim.tv_sec, st->st_mtim.tv_nsec );
+            hash = fru_regen_hash( hash, stamp );
+        }
     }
 
-    if( cia )
+    if( type && type->type_id == MULTI_RECORD_ID_MAR )
     {
-        offset = fch->chassis_info_offset * 8;
-        size = *( cia + 1 ) * 8;
-        memcpy( data + offset, cia, size );
+        switch( get_mar_uuid_version( ini, ns ) )
+        {
+            case 4:
+                return 0;
+            case 5:
+                /* The default v5 name is a serial number */
+                for( i = 0; i < 3; i++ )
+                    hash = fru_regen_hash( hash, fru_config_getstring( ini,
+                                           get_key( serial_sections[i], SERIAL_NUMBER ), NULL ) );
+                break;
+            default:
+                break;
+        }
     }
 
-    if( bia )
+    return hash;
+}
+
+#ifdef FRU_USDT
+/* Number of the image this thread is generating, passed to the probes */
+static unsigned long trace_units;
+static __thread unsigned long trace_unit;
+#endif
+
+/*
+ * Encode one info area, or take it from the regeneration cache. Returns 1
+ * if the area was re-encoded, -1 if its section is invalid. *owned is set
+ * when the caller has to free area->data, i.e. there is no cache or it had
+ * no room for the area.
+ */
+static int encode_area( dictionary *ini, struct fru_area_blob *area, const char *section,
+                        int ( *gen )( dictionary *, char ** ), int scale, int *owned )
+{
+    struct fru_regen_entry *entry;
+    uint64_t hash = 0;
+    int size;
+
+    area->section = section;
+    if( section != IUA && layout_policy.mode == FRU_LAYOUT_HOT_COLD )
+        area->hot = is_hot_section( ini, section );
+    bin_file_stat_valid = 0;
+
+    if( regen_cache )
     {
-        offset = fch->board_info_offset * 8;
-        size = *( bia + 1 ) * 8;
-        memcpy( data + offset, bia, size );
+        hash = input_hash( ini, section );
+        if( hash && ( entry = fru_regen_lookup( regen_cache, section, hash ) ) != NULL )
+        {
+            area->data = entry->data;
+            area->length = entry->length;
+            return 0;
+        }
     }
 
-    if( pia )
+    FRU_STATS_START( start );
+    FRU_TRACE2( area__start, trace_unit, section );
+    size = gen( ini, &area->data );
+    area->length = size < 0 ? -1 : size * scale;
+    FRU_TRACE3( area__done, trace_unit, section, area->length );
+    FRU_STATS_STAGE( section, start );
+    if( size < 0 )
+        return -1;
+    if( area->hot && layout_policy.reserve )
+        fru_pad_info_area( area, layout_policy.reserve );
+
+    *owned = !regen_cache ||
+             !fru_regen_store( regen_cache, section, hash, hash != 0, area->data, area->length );
+
+    return 1;
+}
+
+/* Same for a MultiRecord record, which is appended to the MultiRecord area */
+static int encode_record( dictionary *ini, struct fru_area_blob *mia, const char *section,
+                          const struct mia_record_type *type )
+{
+    struct fru_regen_entry *entry;
+    uint64_t hash = 0;
+    char *record;
+    int size;
+
+    if( regen_cache )
     {
-        offset = fch->product_info_offset * 8;
-        size = *( pia + 1 ) * 8;
-        memcpy( data + offset, pia, size );
+        hash = input_hash( ini, section );
+        if( hash && ( entry = fru_regen_lookup( regen_cache, section, hash ) ) != NULL )
+        {
+            append_record( mia, entry->data, entry->length );
+            return 0;
+        }
     }
 
-    if( mia_mar )
+    FRU_STATS_START( start );
+    FRU_TRACE2( record__start, trace_unit, section );
+    size = type->gen( ini, section, &record );
+    FRU_TRACE3( record__done, trace_unit, section, size );
+    FRU_STATS_STAGE( type->section, start );
+    if( size < 0 )
+        return -1;
+    if( type->type_id >= 0 && !fru_config_find_entry( ini, get_key( section, RECORD_TYPE_ID ) ) )
+        record[0] = type->type_id;
+    append_record( mia, record, size );
+
+    if( !regen_cache || !fru_regen_store( regen_cache, section, hash, hash != 0, record, size ) )
+        free( record );
+
+    return 1;
+}
+
+int gen_fru_data( dictionary *ini, char **raw_data )
+{
+    int total_length,
+        cksum,
+        i;
+
+    char *data;
+
+    /* IUA, CIA, BIA, PIA and the MultiRecord area, in header order */
+    struct fru_area_blob areas[5];
+    struct fru_area_blob *mia = &areas[4];
+    const struct mia_record_type *type;
+    int fresh[5], owned[4];
+    FRU_STATS_START( unit_start );
+
+    FRU_STATS_UNIT_BEGIN();
+    FRU_ALLOC_UNIT_BEGIN();
+#ifdef FRU_USDT
+    trace_unit = __atomic_add_fetch( &trace_units, 1, __ATOMIC_RELAXED );
+#endif
+    FRU_TRACE1( unit__start, trace_unit );
+    memset( areas, 0, sizeof( areas ) );
+    memset( fresh, 0, sizeof( fresh ) );
+    memset( owned, 0, sizeof( owned ) );
+    total_length = cksum = 0;
+    if( regen_cache )
+        regen_cache->encoded = regen_cache->reused = 0;
+
+    /* A common header always exists even if there's no FRU data */
+    struct fru_common_header *fch =
+        ( struct fru_common_header * ) calloc( sizeof( struct fru_common_header ),
+                1 );
+    fch->format_version = 0x01;
+
+    /* Parse "Internal Use Area" (IUA) section */
+    if( fru_config_find_entry( ini, IUA ) &&
+        ( fresh[0] = encode_area( ini, &areas[0], IUA, gen_iua, 1, &owned[0] ) ) < 0 )
+        goto fail;
+
+    /* Parse "Chassis Info Area" (CIA) section */
+    if( fru_config_find_entry( ini, CIA ) &&
+        ( fresh[1] = encode_area( ini, &areas[1], CIA, gen_cia, 8, &owned[1] ) ) < 0 )
+        goto fail;
+
+    /* Parse "Board Info Area" (BIA) section */
+    if( fru_config_find_entry( ini, BIA ) &&
+        ( fresh[2] = encode_area( ini, &areas[2], BIA, gen_bia, 8, &owned[2] ) ) < 0 )
+        goto fail;
+
+    /* Parse "Product Info Area" (PIA) section */
+    if( fru_config_find_entry( ini, PIA ) &&
+        ( fresh[3] = encode_area( ini, &areas[3], PIA, gen_pia, 8, &owned[3] ) ) < 0 )
+        goto fail;
+
+    /* MultiRecord Info Area: one record per mia_* section, in config order */
+    mia->section = "mia";
+    for( i = 0; i < ini->size; i++ )
+    {
+        if( !ini->key[i] || strchr( ini->key[i], ':' ) || strncmp( ini->key[i], "mia_", 4 ) )
+            continue;
+        if( ( type = mia_record_type( ini->key[i] ) ) == NULL )
+        {
+            fprintf( stderr, "\nUnknown MultiRecord section [%s] skipped\n\n", ini->key[i] );
+            continue;
+        }
+        if( encode_record( ini, mia, ini->key[i], type ) < 0 )
+            goto fail;
+        mia->hot |= type->hot;
+    }
+    if( mia->data )
     {
-        memcpy( data + mia_mar_offset, mia_mar, mia_mar_len_mul8 );
+        FRU_STATS_START( cksum_start );
+        seal_records( mia );
+        FRU_STATS_STAGE( "checksum", cksum_start );
+        /* Record order and end-of-list can change without any record changing */
+        fresh[4] = 1;
     }
 
-    if( mia_ver )
+    FRU_STATS_START( assembly_start );
+    /* Nothing moved: refresh the changed areas in the previous image */
+    if( regen_cache && fru_regen_same_shape( regen_cache, areas, 5 ) )
     {
-        memcpy( data + mia_ver_offset, mia_ver, mia_ver_len_mul8 );
+        for( i = 0; i < 5; i++ )
+        {
+            if( fresh[i] )
+                memcpy( regen_cache->image + regen_cache->offsets[i], areas[i].data,
+                        areas[i].length );
+        }
+        regen_cache->relaid = 0;
+        total_length = regen_cache->image_length;
+        data = ( char * ) malloc( total_length );
+        memcpy( data, regen_cache->image, total_length );
+        for( i = 0; i < 4; i++ )
+        {
+            if( owned[i] )
+                free( areas[i].data );
+        }
+        free( mia->data );
+        free( fch );
+        FRU_STATS_STAGE( "assembly", assembly_start );
+        FRU_STATS_UNIT_END( unit_start, total_length );
+        FRU_ALLOC_UNIT_END();
+        FRU_TRACE2( unit__done, trace_unit, total_length );
+
+        *raw_data = data;
+        return total_length;
     }
 
-    if( mia_mac )
+    /* Place everything */
+    total_length = fru_layout_areas( areas, 5, &layout_policy );
+    for( i = 0; i < 5; i++ )
     {
-        memcpy( data + mia_mac_offset, mia_mac, mia_mac_len_mul8 );
+        if( areas[i].data && areas[i].offset > FRU_MAX_AREA_OFFSET )
+        {
+            fprintf( stderr, "\nError! Area %s at offset %d is beyond the %d bytes "
+                     "the common header can point to\n\n", areas[i].section,
+                     areas[i].offset, FRU_MAX_AREA_OFFSET );
+            goto fail;
+        }
     }
 
-    if( mia_fan )
+    if( areas[0].data )
+        fch->internal_use_offset = areas[0].offset / 8;
+    if( areas[1].data )
+        fch->chassis_info_offset = areas[1].offset / 8;
+    if( areas[2].data )
+        fch->board_info_offset = areas[2].offset / 8;
+    if( areas[3].data )
+        fch->product_info_offset = areas[3].offset / 8;
+    if( mia->data )
+        fch->multirecord_info_offset = mia->offset / 8;
+
+    /* calculate header checksum */
+    cksum = get_zero_cksum( ( uint8_t * ) fch, sizeof( *fch ) - 1 );
+    fch->checksum = cksum;
+
+    //    fprintf( stderr, "\ngen_fru_data get size: %d\n", total_length );
+    /* Gaps left by page alignment read as zero */
+    data = ( char * ) calloc( total_length, 1 );
+
+    /* Copy common header first */
+    memcpy( data, fch, sizeof( struct fru_common_header ) );
+
+    /* Copy each section's data if any */
+    for( i = 0; i < 5; i++ )
     {
-        memcpy( data + mia_fan_offset, mia_fan, mia_fan_len_mul8 );
+        if( areas[i].data )
+            memcpy( data + areas[i].offset, areas[i].data, areas[i].length );
     }
 
-    if( mia_bci )
+    if( regen_cache )
     {
-        memcpy( data + mia_bci_offset, mia_bci, mia_bci_len_mul8 );
+        fru_regen_save_image( regen_cache, areas, 5, data, total_length );
+        regen_cache->relaid = 1;
     }
-    if( mia_sysc )
+    for( i = 0; i < 4; i++ )
     {
-        memcpy( data + mia_sysc_offset, mia_sysc, mia_sysc_len_mul8 );
+        if( owned[i] )
+            free( areas[i].data );
     }
+    free( mia->data );
+    free( fch );
+    FRU_STATS_STAGE( "assembly", assembly_start );
+    FRU_STATS_UNIT_END( unit_start, total_length );
+    FRU_ALLOC_UNIT_END();
+    FRU_TRACE2( unit__done, trace_unit, total_length );
+
     *raw_data = data;
 
     return total_length;
+
+fail:
+    for( i = 0; i < 4; i++ )
+    {
+        if( owned[i] )
+            free( areas[i].data );
+    }
+    free( mia->data );
+    free( fch );
+    FRU_ALLOC_UNIT_END();
+    FRU_TRACE2( unit__done, trace_unit, -1 );
+
+    return -1;
 }
 
-int write_fru_data( const char*filename, void *data, int length )
+int write_fru_data( const char*filename, const void *data, int length )
 {
-    int fd, flags;
+    int fd, flags, done, ret;
     mode_t mode;
 
     fd = -1;
     flags = O_RDWR | O_CREAT | O_TRUNC;
     mode = S_IRWXU | S_IRGRP | S_IROTH;
+    FRU_STATS_START( start );
+    FRU_TRACE2( write__start, filename, length );
 
     if( ( fd = open( filename, flags, mode ) ) == -1 )
     {
         perror( "File open:" );
+        FRU_TRACE3( write__done, filename, length, -1 );
         return -1;
     }
 
-    write( fd, data, length );
-    close( fd );
+    for( done = 0; done < length; done += ret )
+    {
+        if( ( ret = write( fd, ( const char * ) data + done, length - done ) ) <= 0 )
+        {
+            perror( "File write:" );
+            close( fd );
+            FRU_STATS_COUNT( FRU_STAT_BYTES_WRITTEN, done );
+            FRU_TRACE3( write__done, filename, length, -1 );
+            return -1;
+        }
+    }
+    FRU_STATS_COUNT( FRU_STAT_BYTES_WRITTEN, length );
+
+    if( close( fd ) )
+    {
+        perror( "File close:" );
+        FRU_TRACE3( write__done, filename, length, -1 );
+        return -1;
+    }
+    FRU_TRACE3( write__done, filename, length, 0 );
+    FRU_STATS_COUNT( FRU_STAT_FILES_WRITTEN, 1 );
+    FRU_STATS_STAGE( "write", start );
 
     return 0;
 }
@@ -1941,22 +2597,263 @@ void ShowHelp( char *str )
     fprintf( stdout, usage, str );
     printf( "\tGenerating a FRU data file using 8-bit ASCII:\n" );
     printf( "\t   ipmi-fru-it -s 2048 -c fru.conf -o FRU.bin -a\n" );
-    printf( "\tReading a FRU data file(Not implemented, please use):\n" );
+    printf( "\tProgramming an at24 EEPROM with 16-byte pages:\n" );
+    printf( "\t   ipmi-fru-it -c fru.conf -a --device /sys/bus/i2c/devices/0-0050/eeprom --page-size 16\n" );
+    printf( "\tReading a FRU data file:\n" );
     printf( "\t   ipmi-fru-it -r -i FRU.bin\n" );
+    printf( "\tChecking a directory of EEPROM dumps against the expected image:\n" );
+    printf( "\t   ipmi-fru-it --diff FRU.bin dumps/ -j 8\n" );
+    printf( "\tCarving FRU images out of a flash dump:\n" );
+    printf( "\t   ipmi-fru-it --scan flash.img -o carved/\n" );
+    printf( "\tDecoding a directory of images for ingestion:\n" );
+    printf( "\t   ls images/*.bin | ipmi-fru-it -r -i - --format json -o fleet.ndjson\n" );
+}
+
+/* Built with -DFRU_IT_LIBRARY the generator is linked into bench/ without main() */
+#ifndef FRU_IT_LIBRARY
+
+/* long-only options */
+enum
+{
+    OPT_DEVICE = 0x100,
+    OPT_PAGE_SIZE,
+    OPT_LAYOUT,
+    OPT_RESERVE,
+    OPT_LAYOUT_REPORT,
+    OPT_MANIFEST,
+    OPT_PATCH,
+    OPT_SET,
+    OPT_CSV,
+    OPT_SEQ,
+    OPT_SERIAL_RANGE,
+    OPT_MAC_POOL,
+    OPT_MAC_POOL_CREATE,
+    OPT_MAC_POOL_CHUNK,
+    OPT_WATCH,
+    OPT_STATS,
+    OPT_TRACE,
+    OPT_FORMAT,
+    OPT_DIFF,
+    OPT_SCAN,
+};
+
+/* Build one image per CSV row, expanding the config templates for each */
+static int gen_csv_batch( dictionary *ini, const struct fru_templates *templates,
+                          struct fru_vars *vars, const char *csv_file,
+                          const char *outfile, int max_size )
+{
+    struct fru_template out_tmpl;
+    struct fru_csv csv;
+    char filename[1024], *data;
+    int count, length, ret;
+
+    if( fru_template_compile( &out_tmpl, NULL, outfile ) <= 0 )
+    {
+        fprintf( stderr, "\nError! Output name \"%s\" must contain a placeholder "
+                 "when building from CSV\n\n", outfile );
+        return -1;
+    }
+    if( fru_csv_open( &csv, csv_file ) )
+        return -1;
+
+    /* Rows usually differ in a few keys: keep the areas that did not change */
+    regen_cache = ( struct fru_regen * ) calloc( 1, sizeof( struct fru_regen ) );
+
+    count = 0;
+    while( ( ret = fru_csv_next( &csv, vars ) ) > 0 )
+    {
+        FRU_STATS_START( start );
+        if( fru_templates_apply( ini, templates, vars ) ||
+            fru_template_expand( &out_tmpl, vars, filename, sizeof( filename ) ) < 0 )
+        {
+            ret = -1;
+            break;
+        }
+        FRU_STATS_STAGE( "templates", start );
+
+        length = gen_fru_data( ini, &data );
+        if( length < 0 )
+        {
+            ret = -1;
+            break;
+        }
+        if( max_size && length > max_size )
+        {
+            fprintf( stderr, "\nError! FRU data length (%d bytes) of %s exceeds maximum "
+                     "file size (%d bytes)\n\n", length, filename, max_size );
+            ret = -1;
+            break;
+        }
+        if( write_fru_data( filename, data, length ) )
+        {
+            fprintf( stderr, "\nError writing %s\n\n", filename );
+            ret = -1;
+            break;
+        }
+        free( data );
+
+        count++;
+        vars->seq++;
+    }
+
+    fru_csv_close( &csv );
+    fru_template_free( &out_tmpl );
+    fru_regen_free( regen_cache );
+    regen_cache = NULL;
+
+    return ret < 0 ? -1 : count;
+}
+
+struct watch_ctx
+{
+    char                **files;
+    int                 num_files;
+    struct fru_vars     *vars;
+    int                 max_size;
+    dictionary          *ini;
+};
+
+/* Reload the configs (unchanged files come from the parse cache) and rebuild */
+static int watch_build( void *arg, char **data, const char **extra_dep )
+{
+    struct watch_ctx *ctx = ( struct watch_ctx * ) arg;
+    struct fru_templates templates;
+    dictionary *ini;
+    int length, i;
+
+    if( ( ini = fru_config_load( ctx->files, ctx->num_files ) ) == NULL )
+        return -1;
+    if( ctx->ini )
+        iniparser_freedict( ctx->ini );
+    ctx->ini = ini;
+
+    *extra_dep = fru_config_getstring( ini, get_key( IUA, BINFILE ), NULL );
+
+    if( fru_templates_compile( ini, &templates ) < 0 )
+        return -1;
+    length = fru_templates_apply( ini, &templates, ctx->vars ) ? -1 : 0;
+    for( i = 0; i < templates.num; i++ )
+        fru_template_free( &templates.templates[i] );
+    free( templates.templates );
+    if( length < 0 )
+        return -1;
+
+    length = gen_fru_data( ini, data );
+    if( ctx->max_size && length > ctx->max_size )
+    {
+        fprintf( stderr, "\nError! FRU data length (%d bytes) exceeds maximum "
+                 "file size (%d bytes)\n\n", length, ctx->max_size );
+        free( *data );
+        return -1;
+    }
+    return length;
+}
+
+/*
+ * -r: decode every input, -i "-" standing for a list of file names on stdin.
+ * Returns the number of images that could not be read or parsed (or, as
+ * INI, reproduced).
+ */
+static int decode_inputs( char **inputs, int num_inputs, const char *outfile, int format )
+{
+    static struct fru_writer writer;
+    char path[PATH_MAX];
+    int fd, i, failed;
+
+    fd = STDOUT_FILENO;
+    if( outfile && ( fd = open( outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644 ) ) == -1 )
+    {
+        perror( "Output open:" );
+        return -1;
+    }
+    fru_writer_init( &writer, fd );
+
+    /* Several images make one multi-FRU config */
+    if( format == FRU_DECODE_INI && ( num_inputs > 1 || !strcmp( inputs[0], "-" ) ) )
+        format |= FRU_DECODE_MULTI;
+
+    failed = 0;
+    for( i = 0; i < num_inputs; i++ )
+    {
+        if( strcmp( inputs[i], "-" ) )
+        {
+            failed += fru_decode_file( &writer, inputs[i], format ) != 0;
+            continue;
+        }
+        while( fgets( path, sizeof( path ), stdin ) )
+        {
+            path[strcspn( path, "\r\n" )] = '\0';
+            if( path[0] )
+                failed += fru_decode_file( &writer, path, format ) != 0;
+        }
+    }
+
+    if( fru_writer_flush( &writer ) )
+        failed++;
+    if( outfile )
+        close( fd );
+
+    return failed;
+}
+
+static void close_mac_pool( void )
+{
+    mac_pool_close( mac_pool );
+    mac_pool = NULL;
 }
 
 int main( int argc, char **argv )
 {
-    char *fru_ini_file, *outfile, *data;
-    int c, length, max_size = 0, result;
+    char *outfile, *device, *manifest, *patch_image, *data, *diff[2] = { NULL, NULL };
+    char **sets = NULL, *csv_file = NULL, **fru_ini_files = NULL, **inputs = NULL;
+    char *mac_pool_file = NULL, *mac_pool_spec = NULL, *scan_file = NULL;
+    long long mac_pool_chunk = -1;
+    int num_sets = 0, num_ini_files = 0, num_inputs = 0;
+    struct fru_vars vars;
+    struct fru_templates templates;
+    struct fru_serial_range serial_range;
+    struct fru_multi multi;
+    char first_serial[64];
+    int serial_mode = 0;
+    int c, i, length, max_size = 0, page_size = EEPROM_DEFAULT_PAGE_SIZE, result;
+    int layout_report = 0, watch = 0, read_mode = 0, format = FRU_DECODE_TEXT;
     dictionary *ini;
+    struct eeprom_flash_stats flash_stats;
 
     /* supported cmdline options */
-    char options[] = "hvri:aws:c:o:";
-
-    fru_ini_file = outfile = data = NULL;
+    char options[] = "hvri:aws:c:o:D:j:";
+    struct option long_options[] =
+    {
+        { "device",    required_argument, NULL, OPT_DEVICE },
+        { "page-size", required_argument, NULL, OPT_PAGE_SIZE },
+        { "layout",    required_argument, NULL, OPT_LAYOUT },
+        { "reserve",   required_argument, NULL, OPT_RESERVE },
+        { "layout-report", no_argument,   NULL, OPT_LAYOUT_REPORT },
+        { "manifest",  required_argument, NULL, OPT_MANIFEST },
+        { "patch",     required_argument, NULL, OPT_PATCH },
+        { "set",       required_argument, NULL, OPT_SET },
+        { "csv",       required_argument, NULL, OPT_CSV },
+        { "seq",       required_argument, NULL, OPT_SEQ },
+        { "serial-range", required_argument, NULL, OPT_SERIAL_RANGE },
+        { "jobs",      required_argument, NULL, 'j' },
+        { "mac-pool",  required_argument, NULL, OPT_MAC_POOL },
+        { "mac-pool-create", required_argument, NULL, OPT_MAC_POOL_CREATE },
+        { "mac-pool-chunk", required_argument, NULL, OPT_MAC_POOL_CHUNK },
+        { "watch",     no_argument,       NULL, OPT_WATCH },
+        { "stats",     optional_argument, NULL, OPT_STATS },
+        { "trace",     required_argument, NULL, OPT_TRACE },
+        { "format",    required_argument, NULL, OPT_FORMAT },
+        { "diff",      required_argument, NULL, OPT_DIFF },
+        { "scan",      required_argument, NULL, OPT_SCAN },
+        { NULL, 0, NULL, 0 }
+    };
+
+    outfile = device = manifest = patch_image = data = NULL;
+    memset( &vars, 0, sizeof( vars ) );
+    vars.seq = 1;
+    memset( &serial_range, 0, sizeof( serial_range ) );
+    serial_range.jobs = 1;
     ini = NULL;
-    fprintf( stdout, "*********FRU BIN GENERATE TOOL V%s********* \n", TOOL_VERSION );
 
     if( argc == 1 )
     {
@@ -1967,16 +2864,37 @@ int main( int argc, char **argv )
     packer = &pack_ascii6;
     //packerascii = &pack_ascii8_length;
 
-    while( ( c = getopt( argc, argv, options ) ) != -1 )
+    while( ( c = getopt_long( argc, argv, options, long_options, NULL ) ) != -1 )
     {
         switch( c )
         {
             case 'r':
-                fprintf( stderr, "\nError! Option not implemented\n\n" );
-                exit( EXIT_FAILURE );
+                read_mode = 1;
+                break;
             case 'i':
-                fprintf( stderr, "\nError! Option not implemented\n\n" );
-                exit( EXIT_FAILURE );
+                inputs = ( char ** ) realloc( inputs, ( num_inputs + 1 ) * sizeof( char * ) );
+                inputs[num_inputs++] = optarg;
+                break;
+            case OPT_DIFF:
+                /* EXPECTED is optarg, ACTUAL follows it */
+                if( optind >= argc )
+                {
+                    fprintf( stderr, "\nError! Usage: --diff EXPECTED ACTUAL\n\n" );
+                    exit( EXIT_FAILURE );
+                }
+                diff[0] = optarg;
+                diff[1] = argv[optind++];
+                break;
+            case OPT_SCAN:
+                scan_file = optarg;
+                break;
+            case OPT_FORMAT:
+                if( ( format = fru_decode_format_by_name( optarg ) ) < 0 )
+                {
+                    fprintf( stderr, "\nError! Unknown format (--format %s)\n\n", optarg );
+                    exit( EXIT_FAILURE );
+                }
+                break;
             case 's':
                 result = sscanf( optarg, "%d", &max_size );
                 if( result == 0 || result == EOF )
@@ -1987,7 +2905,9 @@ int main( int argc, char **argv )
                 }
                 break;
             case 'c':
-                fru_ini_file = optarg;
+                fru_ini_files = ( char ** ) realloc( fru_ini_files,
+                                                     ( num_ini_files + 1 ) * sizeof( char * ) );
+                fru_ini_files[num_ini_files++] = optarg;
                 break;
             case 'o':
                 outfile = optarg;
@@ -1996,6 +2916,118 @@ int main( int argc, char **argv )
                 //packer = &pack_ascii8;
                 packerascii = &pack_ascii8_length;
                 break;
+            case OPT_DEVICE:
+                device = optarg;
+                break;
+            case OPT_PAGE_SIZE:
+                result = sscanf( optarg, "%d", &page_size );
+                if( result == 0 || result == EOF || page_size <= 0 )
+                {
+                    fprintf( stderr, "\nError! Invalid EEPROM page size (--page-size %s)\n\n",
+                             optarg );
+                    exit( EXIT_FAILURE );
+                }
+                break;
+            case OPT_LAYOUT:
+                if( !strcmp( optarg, "packed" ) )
+                    layout_policy.mode = FRU_LAYOUT_PACKED;
+                else if( !strcmp( optarg, "hot-cold" ) )
+                    layout_policy.mode = FRU_LAYOUT_HOT_COLD;
+                else
+                {
+                    fprintf( stderr, "\nError! Unknown layout (--layout %s)\n\n", optarg );
+                    exit( EXIT_FAILURE );
+                }
+                break;
+            case OPT_RESERVE:
+                result = sscanf( optarg, "%d", &layout_policy.reserve );
+                if( result == 0 || result == EOF || layout_policy.reserve < 0 )
+                {
+                    fprintf( stderr, "\nError! Invalid reserve size (--reserve %s)\n\n",
+                             optarg );
+                    exit( EXIT_FAILURE );
+                }
+                break;
+            case OPT_LAYOUT_REPORT:
+                layout_report = 1;
+                break;
+            case OPT_MANIFEST:
+                manifest = optarg;
+                break;
+            case OPT_PATCH:
+                patch_image = optarg;
+                break;
+            case OPT_SET:
+                sets = ( char ** ) realloc( sets, ( num_sets + 1 ) * sizeof( char * ) );
+                sets[num_sets++] = optarg;
+                break;
+            case 'D':
+                if( fru_vars_parse( &vars, optarg ) )
+                {
+                    fprintf( stderr, "\nError! Invalid variable (-D %s)\n\n", optarg );
+                    exit( EXIT_FAILURE );
+                }
+                break;
+            case OPT_CSV:
+                csv_file = optarg;
+                break;
+            case OPT_SERIAL_RANGE:
+                /* PATTERN is optarg, START and COUNT follow it */
+                if( fru_serial_format( optarg, serial_range.format,
+                                       sizeof( serial_range.format ) ) ||
+                    optind + 1 >= argc ||
+                    sscanf( argv[optind], "%lld", &serial_range.start ) != 1 ||
+                    sscanf( argv[optind + 1], "%lld", &serial_range.count ) != 1 ||
+                    serial_range.count <= 0 )
+                {
+                    fprintf( stderr, "\nError! Usage: --serial-range PATTERN START COUNT\n\n" );
+                    exit( EXIT_FAILURE );
+                }
+                optind += 2;
+                serial_mode = 1;
+                break;
+            case 'j':
+                result = sscanf( optarg, "%d", &serial_range.jobs );
+                if( result == 0 || result == EOF || serial_range.jobs <= 0 )
+                {
+                    fprintf( stderr, "\nError! Invalid number of jobs (-j %s)\n\n", optarg );
+                    exit( EXIT_FAILURE );
+                }
+                break;
+            case OPT_MAC_POOL:
+                mac_pool_file = optarg;
+                break;
+            case OPT_MAC_POOL_CREATE:
+                mac_pool_spec = optarg;
+                break;
+            case OPT_MAC_POOL_CHUNK:
+                result = sscanf( optarg, "%lld", &mac_pool_chunk );
+                if( result == 0 || result == EOF || mac_pool_chunk < 0 )
+                {
+                    fprintf( stderr, "\nError! Invalid MAC pool chunk (--mac-pool-chunk %s)\n\n",
+                             optarg );
+                    exit( EXIT_FAILURE );
+                }
+                break;
+            case OPT_WATCH:
+                watch = 1;
+                break;
+            case OPT_STATS:
+                if( fru_stats_enable( optarg ) )
+                    exit( EXIT_FAILURE );
+                break;
+            case OPT_TRACE:
+                if( fru_timeline_enable( optarg ) )
+                    exit( EXIT_FAILURE );
+                break;
+            case OPT_SEQ:
+                result = sscanf( optarg, "%lld", &vars.seq );
+                if( result == 0 || result == EOF )
+                {
+                    fprintf( stderr, "\nError! Invalid sequence start (--seq %s)\n\n", optarg );
+                    exit( EXIT_FAILURE );
+                }
+                break;
 
             case 'v':
                 fprintf( stdout, "\nipmi-fru-it version %s\n\n", TOOL_VERSION );
@@ -2007,16 +3039,231 @@ int main( int argc, char **argv )
         }
     }
 
-    if( !fru_ini_file || !outfile )
+    /* Decoded output may go to stdout, keep it clean */
+    if( read_mode )
+    {
+        for( ; optind < argc; optind++ )
+        {
+            inputs = ( char ** ) realloc( inputs, ( num_inputs + 1 ) * sizeof( char * ) );
+            inputs[num_inputs++] = argv[optind];
+        }
+        if( !num_inputs )
+        {
+            fprintf( stderr, "\nError! -r needs at least one input (-i FILE)\n\n" );
+            exit( EXIT_FAILURE );
+        }
+        result = decode_inputs( inputs, num_inputs, outfile, format );
+        free( inputs );
+        return result ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    /* Like diff(1): 0 if identical, 1 if different, 2 on trouble */
+    if( diff[0] )
+    {
+        result = fru_diff_run( diff[0], diff[1], serial_range.jobs );
+        return result < 0 ? 2 : result > 0;
+    }
+
+    /* Like grep(1): 0 if images were found, 1 if none, 2 on trouble */
+    if( scan_file )
+    {
+        result = fru_scan_file( scan_file, outfile );
+        if( result >= 0 )
+            fprintf( stdout, "%d FRU images found in %s\n", result, scan_file );
+        return result < 0 ? 2 : !result;
+    }
+
+    fprintf( stdout, "*********FRU BIN GENERATE TOOL V%s********* \n", TOOL_VERSION );
+
+    if( patch_image )
+    {
+        if( !num_sets )
+        {
+            fprintf( stderr, "\nError! --patch needs at least one --set\n\n" );
+            exit( EXIT_FAILURE );
+        }
+        if( fru_patch_file( patch_image, sets, num_sets ) )
+        {
+            fprintf( stderr, "\nError patching %s\n\n", patch_image );
+            exit( EXIT_FAILURE );
+        }
+        fprintf( stdout, "\nFRU file \"%s\" patched\n\n", patch_image );
+        return 0;
+    }
+
+    if( mac_pool_spec )
+    {
+        if( !mac_pool_file )
+        {
+            fprintf( stderr, "\nError! --mac-pool-create needs --mac-pool FILE\n\n" );
+            exit( EXIT_FAILURE );
+        }
+        if( mac_pool_create( mac_pool_file, mac_pool_spec ) )
+            exit( EXIT_FAILURE );
+        fprintf( stdout, "\nMAC pool \"%s\" created\n\n", mac_pool_file );
+        if( !num_ini_files )
+            return 0;
+    }
+
+    if( !num_ini_files || ( !outfile && !device ) )
     {
         fprintf( stderr, usage, argv[0] );
         exit( EXIT_FAILURE );
     }
 
-    ini = iniparser_load( fru_ini_file );
+    ini = fru_config_load( fru_ini_files, num_ini_files );
     if( !ini )
+        exit( EXIT_FAILURE );
+
+    layout_policy.page_size = page_size;
+
+    if( fru_templates_compile( ini, &templates ) < 0 )
+        exit( EXIT_FAILURE );
+
+    if( watch && ( !outfile || device || csv_file || serial_mode || mac_pool_file ) )
+    {
+        fprintf( stderr, "\nError! --watch needs -o and cannot be used with --device, "
+                 "--csv, --serial-range or --mac-pool\n\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    multi.num = fru_config_fru_names( ini, &multi.names );
+    if( multi.num && watch )
+    {
+        fprintf( stderr, "\nError! --watch builds a single FRU\n\n" );
+        exit( EXIT_FAILURE );
+    }
+    if( multi.num && ( csv_file || serial_mode || device ) )
     {
-        fprintf( stderr, "\nError parsing INI file %s!\n\n", fru_ini_file );
+        fprintf( stderr, "\nError! A multi-FRU config cannot be used with --csv, "
+                 "--serial-range or --device\n\n" );
+        exit( EXIT_FAILURE );
+    }
+
+    if( mac_pool_file )
+    {
+        if( mac_pool_chunk < 0 )
+            mac_pool_chunk = csv_file || serial_mode ? MAC_POOL_BATCH_CHUNK : 0;
+        if( ( mac_pool = mac_pool_open( mac_pool_file, mac_pool_chunk ) ) == NULL )
+            exit( EXIT_FAILURE );
+        /* Unused addresses go back to the pool however we leave */
+        atexit( close_mac_pool );
+    }
+
+    if( csv_file )
+    {
+        if( !outfile )
+        {
+            fprintf( stderr, "\nError! --csv needs an output name template (-o)\n\n" );
+            exit( EXIT_FAILURE );
+        }
+        length = gen_csv_batch( ini, &templates, &vars, csv_file, outfile, max_size );
+        if( length < 0 )
+            exit( EXIT_FAILURE );
+        fprintf( stdout, "\n%d FRU files created from \"%s\"\n\n", length, csv_file );
+        return 0;
+    }
+
+    if( serial_mode )
+    {
+        if( !outfile )
+        {
+            fprintf( stderr, "\nError! --serial-range needs an output name template (-o)\n\n" );
+            exit( EXIT_FAILURE );
+        }
+        /*
+         * The golden image is the first unit, so ${SERIAL} and ${SEQ} in the
+         * config resolve; fields using them are expanded again per unit
+         */
+        snprintf( first_serial, sizeof( first_serial ), serial_range.format, serial_range.start );
+        fru_vars_set( &vars, "SERIAL", first_serial );
+        vars.seq = serial_range.start;
+        if( templates.num && fru_templates_apply( ini, &templates, &vars ) )
+            exit( EXIT_FAILURE );
+
+        /* The golden image needs one unit worth of addresses, not a chunk */
+        if( mac_pool )
+            mac_pool->chunk = 0;
+        length = gen_fru_data( ini, &data );
+        if( mac_pool )
+            mac_pool->chunk = mac_pool_chunk;
+        if( length < 0 )
+            exit( EXIT_FAILURE );
+        serial_range.outfile = outfile;
+        serial_range.mac_pool = mac_pool;
+        serial_range.ini = ini;
+        serial_range.templates = &templates;
+        serial_range.vars = &vars;
+        if( fru_config_find_entry( ini, MIA_MAR ) )
+        {
+            serial_range.uuid_version = get_mar_uuid_version( ini, serial_range.uuid_namespace );
+            /* A v5 name other than the serial is expanded again for every unit */
+            serial_range.uuid_name = fru_config_getstring( ini, get_key( MIA_MAR, UUID_NAME ), NULL );
+            for( i = 0; i < templates.num; i++ )
+            {
+                if( !strcmp( templates.templates[i].key, get_key( MIA_MAR, UUID_NAME ) ) )
+                    serial_range.uuid_name = templates.templates[i].source;
+            }
+        }
+        length = fru_serial_range_run( ( uint8_t * ) data, length, &serial_range );
+        if( length < 0 )
+            exit( EXIT_FAILURE );
+        fprintf( stdout, "\n%d FRU files created\n\n", length );
+        return 0;
+    }
+
+    /* Single unit: expand the templates and the output name once */
+    if( templates.num && fru_templates_apply( ini, &templates, &vars ) )
+        exit( EXIT_FAILURE );
+
+    if( multi.num )
+    {
+        if( !outfile )
+        {
+            fprintf( stderr, "\nError! A multi-FRU config needs an output name template (-o)\n\n" );
+            exit( EXIT_FAILURE );
+        }
+        /* Threads share the pool, each allocation goes straight to the counter */
+        if( mac_pool )
+            mac_pool->chunk = 0;
+        multi.jobs = serial_range.jobs;
+        multi.max_size = max_size;
+        multi.outfile = outfile;
+        length = fru_multi_run( ini, &multi, gen_fru_data );
+        if( length < 0 )
+            exit( EXIT_FAILURE );
+        fprintf( stdout, "\n%d FRU files created\n\n", length );
+        return 0;
+    }
+    if( outfile && strstr( outfile, "${" ) )
+    {
+        struct fru_template out_tmpl;
+        static char filename[1024];
+
+        if( fru_template_compile( &out_tmpl, NULL, outfile ) < 0 ||
+            fru_template_expand( &out_tmpl, &vars, filename, sizeof( filename ) ) < 0 )
+            exit( EXIT_FAILURE );
+        fru_template_free( &out_tmpl );
+        outfile = filename;
+    }
+
+    if( watch )
+    {
+        struct watch_ctx ctx;
+        struct fru_watch w;
+
+        ctx.files = fru_ini_files;
+        ctx.num_files = num_ini_files;
+        ctx.vars = &vars;
+        ctx.max_size = max_size;
+        ctx.ini = ini;
+        w.outfile = outfile;
+        w.build = watch_build;
+        w.ctx = &ctx;
+
+        /* An edit usually touches one area: keep the others between builds */
+        regen_cache = ( struct fru_regen * ) calloc( 1, sizeof( struct fru_regen ) );
+        fru_watch_run( &w );
         exit( EXIT_FAILURE );
     }
 
@@ -2036,15 +3283,39 @@ int main( int argc, char **argv )
         exit( EXIT_FAILURE );
     }
 
-    if( write_fru_data( outfile, data, length ) )
+    if( layout_report )
+        fru_layout_report( ( uint8_t * ) data, length, page_size, stdout );
+
+    if( outfile && write_fru_data( outfile, data, length ) )
     {
         fprintf( stderr, "\nError writing %s\n\n", outfile );
         exit( EXIT_FAILURE );
     }
 
+    if( manifest && write_fru_manifest( manifest, ini, ( uint8_t * ) data, length ) )
+    {
+        fprintf( stderr, "\nError writing %s\n\n", manifest );
+        exit( EXIT_FAILURE );
+    }
+
+    if( device )
+    {
+        if( eeprom_flash( device, ( uint8_t * ) data, length, page_size, &flash_stats ) )
+        {
+            fprintf( stderr, "\nError programming %s\n\n", device );
+            exit( EXIT_FAILURE );
+        }
+        fprintf( stdout, "\nEEPROM \"%s\": %d of %d pages (%d bytes) written, verified\n",
+                 device, flash_stats.pages_written, flash_stats.pages_total,
+                 flash_stats.bytes_written );
+    }
+
     iniparser_freedict( ini );
 
-    fprintf( stdout, "\nFRU file \"%s\" created\n\n", outfile );
+    if( outfile )
+        fprintf( stdout, "\nFRU file \"%s\" created\n\n", outfile );
 
     return 0;
 }
+
+#endif /* FRU_IT_LIBRARY */
@@ -0,0 +1,20 @@
+#ifndef IPMI_FRU_IT_H
+#define IPMI_FRU_IT_H
+
+#include <inttypes.h>
+
+#include "iniparser.h"
+
+/*
+ * Generator helpers shared with the fru-* modules and bench/
+ *
+ * Areas are aligned, checksummed and written the same way wherever an
+ * image is built or patched, so there is one copy of each.
+ */
+
+int get_aligned_size( int size, int align );
+uint8_t get_zero_cksum( const uint8_t *data, int num_bytes );
+int gen_fru_data( dictionary *ini, char **raw_data );
+int write_fru_data( const char *filename, const void *data, int length );
+
+#endif
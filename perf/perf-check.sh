@@ -0,0 +1,116 @@
+#!/bin/bash
+# Golden image and throughput regression check (make perf-check)
+#
+#   perf/perf-check.sh            compare against perf/golden and perf/thresholds
+#   perf/perf-check.sh --update   store the current images and timings instead
+#
+# Every corpus entry must build images byte-identical to its golden ones,
+# and decoding them with -r --format ini must give a config that rebuilds
+# them byte for byte.
+# Every fru-bench benchmark may run at most PERF_TOLERANCE percent (default
+# 20) slower than its stored median. Timings are machine specific: refresh
+# them with make perf-baseline on the machine the check runs on.
+
+thisfullscriptname=$(dirname $0)
+basepath=$(realpath $thisfullscriptname/..)
+
+cd "${basepath}"
+
+TOOL=./ipmi-fru-it
+BENCH=./bench/fru-bench
+GOLDEN=perf/golden
+THRESHOLDS=perf/thresholds
+TOLERANCE=${PERF_TOLERANCE:-20}
+
+# name|output name|arguments
+CORPUS=(
+    'fru|fru.bin|-c fru.conf -c perf/fixed-date.conf -a'
+    'mia-all|fru.bin|-c perf/mia-all.conf -a'
+    'mia-all-hot-cold|fru.bin|-c perf/mia-all.conf -a --layout hot-cold --reserve 16'
+    'multi-fru|${FRU}.bin|-c perf/multi-fru.conf -a -j 4'
+)
+
+update=0
+if [ "$1" = "--update" ]; then
+    update=1
+fi
+
+tmp=$(mktemp -d)
+trap 'rm -rf "${tmp}"' EXIT
+failed=0
+
+for entry in "${CORPUS[@]}"; do
+    IFS='|' read -r name output args <<< "${entry}"
+    mkdir -p "${tmp}/${name}"
+    if ! ${TOOL} ${args} -o "${tmp}/${name}/${output}" > "${tmp}/${name}.log" 2>&1; then
+        echo "FAIL ${name}: generation failed"
+        cat "${tmp}/${name}.log"
+        failed=1
+        continue
+    fi
+
+    if [ ${update} -eq 1 ]; then
+        rm -rf "${GOLDEN}/${name}"
+        mkdir -p "${GOLDEN}"
+        cp -r "${tmp}/${name}" "${GOLDEN}/${name}"
+        echo "stored ${name}"
+    elif diff -r "${GOLDEN}/${name}" "${tmp}/${name}"; then
+        echo "ok   ${name}"
+    else
+        echo "FAIL ${name}: images differ from ${GOLDEN}/${name}"
+        failed=1
+    fi
+
+    # Same arguments, with the decoded config instead of the -c ones
+    rt_args=$(sed 's/-c [^ ]*//g' <<< "${args}")
+    mkdir -p "${tmp}/${name}.rt"
+    if ! ${TOOL} -r --format ini -o "${tmp}/${name}.conf" "${tmp}/${name}"/*.bin ||
+       ! ${TOOL} -c "${tmp}/${name}.conf" ${rt_args} -o "${tmp}/${name}.rt/${output}" \
+            > "${tmp}/${name}.log" 2>&1; then
+        echo "FAIL ${name}: round trip"
+        grep '^; lossy' "${tmp}/${name}.conf"
+        cat "${tmp}/${name}.log"
+        failed=1
+    elif diff -r "${tmp}/${name}" "${tmp}/${name}.rt"; then
+        echo "ok   ${name} round trip"
+    else
+        echo "FAIL ${name}: images rebuilt from the decoded config differ"
+        failed=1
+    fi
+done
+
+# One "name median_ns" pair per line
+if ! ${BENCH} -o "${tmp}/bench.json"; then
+    echo "FAIL fru-bench"
+    exit 1
+fi
+sed -n 's/.*"name": "\([^"]*\)".*"median_ns": \([0-9.]*\).*/\1 \2/p' "${tmp}/bench.json" \
+    > "${tmp}/medians"
+
+if [ ${update} -eq 1 ]; then
+    {
+        echo "# fru-bench median ns per iteration on $(uname -m), from make perf-baseline"
+        cat "${tmp}/medians"
+    } > "${THRESHOLDS}"
+    echo "stored ${THRESHOLDS}"
+    exit ${failed}
+fi
+
+while read -r name median; do
+    case "${name}" in
+        ''|'#'*) continue ;;
+    esac
+    current=$(awk -v n="${name}" '$1 == n { print $2 }' "${tmp}/medians")
+    if [ -z "${current}" ]; then
+        echo "FAIL ${name}: no longer benchmarked"
+        failed=1
+    elif awk -v c="${current}" -v m="${median}" -v t="${TOLERANCE}" \
+             'BEGIN { exit !( c > m * ( 100 + t ) / 100 ) }'; then
+        echo "FAIL ${name}: ${current} ns, stored ${median} ns (+${TOLERANCE}% allowed)"
+        failed=1
+    else
+        echo "ok   ${name}: ${current} ns (stored ${median} ns)"
+    fi
+done < "${THRESHOLDS}"
+
+exit ${failed}